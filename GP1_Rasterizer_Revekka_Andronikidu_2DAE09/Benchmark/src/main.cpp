@@ -0,0 +1,352 @@
+//External includes
+#include "SDL.h"
+#undef main
+
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "Renderer.h"
+#include "Profiler.h"
+#include "Scene.h"
+
+using namespace dae;
+
+/**
+ * Headless benchmark: renders a fixed camera and rotation script for a fixed amount of frames and reports frame time statistics.
+ * Every run with the same arguments renders the exact same frames, so results of two builds can be compared directly.
+ *
+ * Usage: Benchmark [-mesh vehicle|tuktuk|<path.obj>] [-instances N] [-frames N] [-warmup N] [-width W] [-height H] [-threads N]
+ *                  [-pipeline forward|deferred|prepass] [-filter point|bilinear|trilinear]
+ *                  [-texlayout linear|tiled] [-reorder on|off] [-json <file>] [-csv <file>] [-trace <file>]
+ *
+ * -instances draws the mesh N times, the copies stand in a grid behind the rotating one and share its vertices and material.
+ */
+
+struct BenchmarkSettings
+{
+	std::string meshPath{ "Resources/vehicle.obj" };
+	int instanceCount{ 1 };
+	int frameCount{ 500 };
+	int warmupCount{ 20 };
+	int width{ 640 };
+	int height{ 480 };
+	uint32_t workerCount{ 0 };
+	Renderer::PipelineMode pipelineMode{ Renderer::PipelineMode::Forward };
+	std::string pipelineName{ "forward" };
+	TextureFilter textureFilter{ TextureFilter::Trilinear };
+	std::string filterName{ "trilinear" };
+	TextureLayout textureLayout{ TextureLayout::Linear };
+	std::string layoutName{ "linear" };
+	bool optimizeVertexOrder{ true };
+	std::string jsonPath{};
+	std::string csvPath{};
+	std::string tracePath{}; // turns on the profiler, costs some frame time
+};
+
+// A point of the camera path, the script interpolates linearly between them
+struct CameraKey
+{
+	Vector3 origin{};
+	float pitch{};
+	float yaw{};
+};
+
+struct FrameTiming
+{
+	float frameMs{};
+	Renderer::PassTimings passTimings{};
+};
+
+//orbits in front of the mesh: far, close up, from the side and back
+static const CameraKey s_CameraPath[]
+{
+	{ { 0.f, 5.f, -64.f }, 0.f, 0.f },
+	{ { 0.f, 2.f, -30.f }, 0.f, 0.f },
+	{ { -20.f, 8.f, -35.f }, 0.15f, 0.5f },
+	{ { 20.f, 8.f, -35.f }, 0.15f, -0.5f },
+	{ { 0.f, 5.f, -64.f }, 0.f, 0.f }
+};
+
+static const float s_RotationPerFrame{ 1.f }; // degrees
+static const float s_InstanceSpacing{ 20.f };
+
+// Every copy after the first one goes in a grid that starts one row behind the rotating mesh, rows are centered on it
+static void AddInstanceGrid(Scene& scene, int instanceCount)
+{
+	const MeshInstance original{ scene.GetInstance(0) };
+	const int numColumns{ static_cast<int>(std::ceil(std::sqrt(float(instanceCount - 1)))) };
+	for (int copyIdx{}; copyIdx < instanceCount - 1; ++copyIdx)
+	{
+		const int column{ copyIdx % numColumns };
+		const int row{ copyIdx / numColumns + 1 };
+		const Vector3 offset{ (column - (numColumns - 1) * 0.5f) * s_InstanceSpacing, 0.f, row * s_InstanceSpacing };
+
+		const uint32_t instanceIdx{ scene.AddInstance(original.meshIdx, original.materialIdx, original.worldMatrix) };
+		scene.GetInstance(instanceIdx).RotateY(copyIdx * 35.f);
+		scene.GetInstance(instanceIdx).Translate(offset);
+	}
+}
+
+static CameraKey SampleCameraPath(float t)
+{
+	const int numSegments{ static_cast<int>(std::size(s_CameraPath)) - 1 };
+	const float segment{ std::clamp(t, 0.f, 1.f) * numSegments };
+	const int segmentIdx{ std::min(static_cast<int>(segment), numSegments - 1) };
+	const float alpha{ segment - segmentIdx };
+
+	const CameraKey& from{ s_CameraPath[segmentIdx] };
+	const CameraKey& to{ s_CameraPath[segmentIdx + 1] };
+	return CameraKey
+	{
+		from.origin + (to.origin - from.origin) * alpha,
+		Lerpf(from.pitch, to.pitch, alpha),
+		Lerpf(from.yaw, to.yaw, alpha)
+	};
+}
+
+static bool ParseArguments(int argc, char* args[], BenchmarkSettings& settings)
+{
+	for (int argIdx{ 1 }; argIdx < argc; ++argIdx)
+	{
+		const std::string argument{ args[argIdx] };
+		if (argIdx + 1 >= argc)
+		{
+			std::cout << "Missing value for " << argument << std::endl;
+			return false;
+		}
+		const std::string value{ args[++argIdx] };
+
+		if (argument == "-mesh")
+		{
+			if (value == "vehicle" || value == "tuktuk")
+				settings.meshPath = "Resources/" + value + ".obj";
+			else
+				settings.meshPath = value;
+		}
+		else if (argument == "-instances")
+			settings.instanceCount = std::max(std::atoi(value.c_str()), 1);
+		else if (argument == "-frames")
+			settings.frameCount = std::max(std::atoi(value.c_str()), 1);
+		else if (argument == "-warmup")
+			settings.warmupCount = std::max(std::atoi(value.c_str()), 0);
+		else if (argument == "-width")
+			settings.width = std::max(std::atoi(value.c_str()), 1);
+		else if (argument == "-height")
+			settings.height = std::max(std::atoi(value.c_str()), 1);
+		else if (argument == "-threads")
+			settings.workerCount = static_cast<uint32_t>(std::max(std::atoi(value.c_str()), 0));
+		else if (argument == "-pipeline")
+		{
+			if (value == "forward")
+				settings.pipelineMode = Renderer::PipelineMode::Forward;
+			else if (value == "deferred")
+				settings.pipelineMode = Renderer::PipelineMode::Deferred;
+			else if (value == "prepass")
+				settings.pipelineMode = Renderer::PipelineMode::DepthPrepass;
+			else
+			{
+				std::cout << "Unknown pipeline " << value << std::endl;
+				return false;
+			}
+			settings.pipelineName = value;
+		}
+		else if (argument == "-filter")
+		{
+			if (value == "point")
+				settings.textureFilter = TextureFilter::Point;
+			else if (value == "bilinear")
+				settings.textureFilter = TextureFilter::Bilinear;
+			else if (value == "trilinear")
+				settings.textureFilter = TextureFilter::Trilinear;
+			else
+			{
+				std::cout << "Unknown filter " << value << std::endl;
+				return false;
+			}
+			settings.filterName = value;
+		}
+		else if (argument == "-texlayout")
+		{
+			if (value == "linear")
+				settings.textureLayout = TextureLayout::Linear;
+			else if (value == "tiled")
+				settings.textureLayout = TextureLayout::Tiled;
+			else
+			{
+				std::cout << "Unknown texture layout " << value << std::endl;
+				return false;
+			}
+			settings.layoutName = value;
+		}
+		else if (argument == "-reorder")
+			settings.optimizeVertexOrder = value != "off";
+		else if (argument == "-json")
+			settings.jsonPath = value;
+		else if (argument == "-csv")
+			settings.csvPath = value;
+		else if (argument == "-trace")
+			settings.tracePath = value;
+		else
+		{
+			std::cout << "Unknown argument " << argument << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Nearest rank percentile of sorted values
+static float Percentile(const std::vector<float>& sortedValues, float percentile)
+{
+	const size_t rank{ static_cast<size_t>(std::ceil(percentile / 100.f * sortedValues.size())) };
+	return sortedValues[std::clamp(rank, size_t{ 1 }, sortedValues.size()) - 1];
+}
+
+struct Statistics
+{
+	float min{};
+	float avg{};
+	float p50{};
+	float p95{};
+	float p99{};
+	float max{};
+};
+
+static Statistics CalculateStatistics(std::vector<float> values)
+{
+	std::sort(values.begin(), values.end());
+
+	double total{};
+	for (const float value : values)
+	{
+		total += value;
+	}
+
+	return Statistics
+	{
+		values.front(),
+		static_cast<float>(total / values.size()),
+		Percentile(values, 50.f),
+		Percentile(values, 95.f),
+		Percentile(values, 99.f),
+		values.back()
+	};
+}
+
+static void WriteStatisticsJson(std::ostream& stream, const Statistics& statistics)
+{
+	stream << "{ \"min\": " << statistics.min << ", \"avg\": " << statistics.avg << ", \"p50\": " << statistics.p50
+		<< ", \"p95\": " << statistics.p95 << ", \"p99\": " << statistics.p99 << ", \"max\": " << statistics.max << " }";
+}
+
+int main(int argc, char* args[])
+{
+	BenchmarkSettings settings{};
+	if (!ParseArguments(argc, args, settings))
+		return 1;
+
+	Renderer* pRenderer{ new Renderer(settings.width, settings.height, settings.workerCount) };
+	if (!pRenderer->LoadMesh(settings.meshPath, settings.optimizeVertexOrder))
+	{
+		std::cout << "Could not load " << settings.meshPath << std::endl;
+		delete pRenderer;
+		return 1;
+	}
+	AddInstanceGrid(pRenderer->GetScene(), settings.instanceCount);
+	pRenderer->SetPipelineMode(settings.pipelineMode);
+	pRenderer->SetTextureFilter(settings.textureFilter);
+	pRenderer->GetScene().SetTextureLayout(settings.textureLayout);
+	Profiler::SetEnabled(!settings.tracePath.empty());
+
+	std::cout << "Benchmarking " << settings.meshPath << " x" << settings.instanceCount << " at " << settings.width << "x" << settings.height
+		<< ", " << settings.frameCount << " frames (+" << settings.warmupCount << " warmup)" << std::endl;
+
+	std::vector<FrameTiming> frameTimings{};
+	frameTimings.reserve(settings.frameCount);
+
+	using Clock = std::chrono::steady_clock;
+	const int totalFrames{ settings.warmupCount + settings.frameCount };
+	for (int frameIdx{}; frameIdx < totalFrames; ++frameIdx)
+	{
+		//warmup frames replay the start of the path, the measured frames always see the whole path
+		const int scriptFrame{ std::max(frameIdx - settings.warmupCount, 0) };
+		const CameraKey camera{ SampleCameraPath(scriptFrame / float(std::max(settings.frameCount - 1, 1))) };
+		pRenderer->SetCamera(camera.origin, camera.pitch, camera.yaw);
+		pRenderer->SetMeshRotation(scriptFrame * s_RotationPerFrame);
+
+		const Clock::time_point frameStart{ Clock::now() };
+		pRenderer->Render();
+		const float frameMs{ std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count() };
+
+		if (frameIdx >= settings.warmupCount)
+		{
+			frameTimings.push_back(FrameTiming{ frameMs, pRenderer->GetPassTimings() });
+		}
+	}
+
+	std::vector<float> frameMs{}, geometryMs{}, depthMs{}, shadingMs{};
+	for (const FrameTiming& timing : frameTimings)
+	{
+		frameMs.push_back(timing.frameMs);
+		geometryMs.push_back(timing.passTimings.geometryMs);
+		depthMs.push_back(timing.passTimings.depthMs);
+		shadingMs.push_back(timing.passTimings.shadingMs);
+	}
+
+	const Statistics frameStatistics{ CalculateStatistics(frameMs) };
+	const Statistics geometryStatistics{ CalculateStatistics(geometryMs) };
+	const Statistics depthStatistics{ CalculateStatistics(depthMs) };
+	const Statistics shadingStatistics{ CalculateStatistics(shadingMs) };
+
+	std::cout << "frame    min " << frameStatistics.min << "ms, avg " << frameStatistics.avg << "ms, p50 " << frameStatistics.p50
+		<< "ms, p95 " << frameStatistics.p95 << "ms, p99 " << frameStatistics.p99 << "ms" << std::endl;
+	std::cout << "geometry avg " << geometryStatistics.avg << "ms, depth avg " << depthStatistics.avg << "ms, shading avg " << shadingStatistics.avg << "ms" << std::endl;
+
+	if (!settings.jsonPath.empty())
+	{
+		std::ofstream json{ settings.jsonPath };
+		json << "{\n";
+		json << "\t\"mesh\": \"" << settings.meshPath << "\",\n";
+		json << "\t\"instances\": " << settings.instanceCount << ",\n";
+		json << "\t\"width\": " << settings.width << ",\n";
+		json << "\t\"height\": " << settings.height << ",\n";
+		json << "\t\"frames\": " << settings.frameCount << ",\n";
+		json << "\t\"pipeline\": \"" << settings.pipelineName << "\",\n";
+		json << "\t\"filter\": \"" << settings.filterName << "\",\n";
+		json << "\t\"textureLayout\": \"" << settings.layoutName << "\",\n";
+		json << "\t\"reorder\": " << (settings.optimizeVertexOrder ? "true" : "false") << ",\n";
+		json << "\t\"frameMs\": "; WriteStatisticsJson(json, frameStatistics); json << ",\n";
+		json << "\t\"geometryMs\": "; WriteStatisticsJson(json, geometryStatistics); json << ",\n";
+		json << "\t\"depthMs\": "; WriteStatisticsJson(json, depthStatistics); json << ",\n";
+		json << "\t\"shadingMs\": "; WriteStatisticsJson(json, shadingStatistics); json << "\n";
+		json << "}\n";
+	}
+
+	if (!settings.csvPath.empty())
+	{
+		std::ofstream csv{ settings.csvPath };
+		csv << "frame,frameMs,geometryMs,depthMs,shadingMs\n";
+		for (size_t frameIdx{}; frameIdx < frameTimings.size(); ++frameIdx)
+		{
+			const FrameTiming& timing{ frameTimings[frameIdx] };
+			csv << frameIdx << ',' << timing.frameMs << ',' << timing.passTimings.geometryMs << ','
+				<< timing.passTimings.depthMs << ',' << timing.passTimings.shadingMs << '\n';
+		}
+	}
+
+	if (!settings.tracePath.empty() && !Profiler::WriteChromeTrace(settings.tracePath))
+	{
+		std::cout << "Could not write " << settings.tracePath << std::endl;
+	}
+
+	delete pRenderer;
+	return 0;
+}
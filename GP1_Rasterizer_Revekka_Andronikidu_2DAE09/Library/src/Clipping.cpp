@@ -0,0 +1,98 @@
+#include "Clipping.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	// Signed distance to a clip plane, inside is >= 0
+	using PlaneDistance = float(*)(const Vector4& position);
+
+	float GetNearDistance(const Vector4& position) { return position.z - Clipping::MinDepth * position.w; }
+	float GetFarDistance(const Vector4& position) { return position.w - position.z; }
+	float GetLeftDistance(const Vector4& position) { return Clipping::GuardBand * position.w + position.x; }
+	float GetRightDistance(const Vector4& position) { return Clipping::GuardBand * position.w - position.x; }
+	float GetBottomDistance(const Vector4& position) { return Clipping::GuardBand * position.w + position.y; }
+	float GetTopDistance(const Vector4& position) { return Clipping::GuardBand * position.w - position.y; }
+
+	// Attributes are linear in clip space, so they are interpolated with the same t as the position
+	ClipVertex Intersect(const ClipVertex& inside, const ClipVertex& outside, float insideDistance, float outsideDistance)
+	{
+		const float t{ insideDistance / (insideDistance - outsideDistance) };
+
+		ClipVertex vertex{};
+		vertex.position = inside.position + (outside.position - inside.position) * t;
+		vertex.uv = inside.uv + (outside.uv - inside.uv) * t;
+		vertex.normal = inside.normal + (outside.normal - inside.normal) * t;
+		vertex.tangent = inside.tangent + (outside.tangent - inside.tangent) * t;
+		vertex.viewDirection = inside.viewDirection + (outside.viewDirection - inside.viewDirection) * t;
+		return vertex;
+	}
+
+	int ClipAgainstPlane(const ClipVertex* pInput, int inputCount, ClipVertex* pOutput, PlaneDistance GetDistance)
+	{
+		int outputCount{};
+		for (int vertexIdx{}; vertexIdx < inputCount; ++vertexIdx)
+		{
+			const ClipVertex& current{ pInput[vertexIdx] };
+			const ClipVertex& next{ pInput[(vertexIdx + 1) % inputCount] };
+			const float currentDistance{ GetDistance(current.position) };
+			const float nextDistance{ GetDistance(next.position) };
+
+			const bool isCurrentInside{ currentDistance >= 0.f };
+			if (isCurrentInside)
+			{
+				pOutput[outputCount++] = current;
+			}
+
+			//always interpolated from the inside vertex, so an edge shared by two triangles is cut at the exact same point in both
+			if (isCurrentInside != (nextDistance >= 0.f))
+			{
+				pOutput[outputCount++] = isCurrentInside ? Intersect(current, next, currentDistance, nextDistance) : Intersect(next, current, nextDistance, currentDistance);
+			}
+		}
+		return outputCount;
+	}
+}
+
+uint8_t Clipping::GetClipCode(const Vector4& position)
+{
+	uint8_t clipCode{};
+	if (position.z < MinDepth * position.w) clipCode |= Near;
+	if (position.z > position.w) clipCode |= Far;
+	if (position.x < -position.w) clipCode |= Left;
+	if (position.x > position.w) clipCode |= Right;
+	if (position.y < -position.w) clipCode |= Bottom;
+	if (position.y > position.w) clipCode |= Top;
+
+	const float guardBand{ GuardBand * position.w };
+	if (position.x < -guardBand || position.x > guardBand || position.y < -guardBand || position.y > guardBand) clipCode |= OutsideGuardBand;
+
+	return clipCode;
+}
+
+int Clipping::ClipPolygon(ClipVertex* pVertices, int vertexCount, uint8_t clipCodes)
+{
+	ClipVertex clipped[MaxPolygonSize]{};
+
+	const auto ClipAgainst = [&](PlaneDistance GetDistance)
+		{
+			if (vertexCount == 0) return;
+
+			vertexCount = ClipAgainstPlane(pVertices, vertexCount, clipped, GetDistance);
+			std::copy_n(clipped, vertexCount, pVertices);
+		};
+
+	if (clipCodes & Near) ClipAgainst(GetNearDistance);
+	if (clipCodes & Far) ClipAgainst(GetFarDistance);
+	if (clipCodes & OutsideGuardBand)
+	{
+		ClipAgainst(GetLeftDistance);
+		ClipAgainst(GetRightDistance);
+		ClipAgainst(GetBottomDistance);
+		ClipAgainst(GetTopDistance);
+	}
+
+	return vertexCount;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+
+#include "Maths.h"
+
+namespace dae
+{
+	// A triangle corner in homogeneous clip space with the attributes that get interpolated across it
+	struct ClipVertex
+	{
+		Vector4 position{}; // clip space, before the divide by w
+		Vector2 uv{};
+		Vector3 normal{};
+		Vector3 tangent{};
+		Vector3 viewDirection{};
+		uint32_t vertexIdx{ UINT32_MAX }; // the mesh vertex this is, UINT32_MAX for vertices made by clipping
+	};
+
+	/**
+	 * Sutherland-Hodgman clipping in homogeneous clip space, before the divide by w, so vertices behind the camera are handled correctly.
+	 * Triangles are always clipped against the near and far plane. Left, right, top and bottom are left to the scissor of the rasterizer
+	 * (the bounding box is clamped to the screen), only triangles reaching outside the guard band get clipped against it,
+	 * which keeps the screen space coordinates small enough for the float edge functions.
+	 */
+	namespace Clipping
+	{
+		// [-GuardBand, GuardBand] in NDC on x and y
+		constexpr float GuardBand{ 4.f };
+		// The near plane is moved to this NDC depth, the rasterizer interpolates 1 / depth
+		constexpr float MinDepth{ 1e-3f };
+		// Every plane adds at most one vertex to a convex polygon, a triangle has 6 planes to go through
+		constexpr int MaxPolygonSize{ 3 + 6 };
+
+		// Which planes a vertex is outside of
+		enum ClipCode : uint8_t
+		{
+			Near = 1 << 0,
+			Far = 1 << 1,
+			Left = 1 << 2,
+			Right = 1 << 3,
+			Bottom = 1 << 4,
+			Top = 1 << 5,
+			OutsideGuardBand = 1 << 6
+		};
+
+		// A triangle with all its vertices outside the same one of these planes can't be visible
+		constexpr uint8_t FrustumPlanes{ Near | Far | Left | Right | Bottom | Top };
+		// A triangle with a vertex outside one of these has to be clipped
+		constexpr uint8_t ClipPlanes{ Near | Far | OutsideGuardBand };
+
+		// position in clip space, with x already divided by the aspect ratio like the vertex stage does
+		uint8_t GetClipCode(const Vector4& position);
+
+		// Clips the convex polygon in place against the planes in clipCodes (see ClipPlanes) and returns its new vertex count, 0 when nothing is left.
+		// pVertices needs room for MaxPolygonSize vertices. Vertices that are kept stay untouched, so they keep their vertexIdx
+		int ClipPolygon(ClipVertex* pVertices, int vertexCount, uint8_t clipCodes);
+	}
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "Maths.h"
 #include "vector"
+#include <algorithm>
+#include <cstdint>
 
 namespace dae
 {
@@ -19,6 +21,8 @@ namespace dae
 		Vector4 position{};
 		ColorRGB color{ colors::White };
 		Vector2 uv{};
+		Vector2 uvDdx{}; // change of the uv one pixel to the right, for the mip level
+		Vector2 uvDdy{}; // and one pixel down
 		Vector3 normal{};
 		Vector3 tangent{};
 		Vector3 viewDirection{};
@@ -29,44 +33,138 @@ namespace dae
 		}
 	};
 
-	enum class PrimitiveTopology
+	// The vertices of a mesh as one array per attribute (structure of arrays), so every stage only loads the attributes it uses
+	struct VertexStreams
 	{
-		TriangleList,
-		TriangleStrip
-	};
+		VertexStreams() = default;
+		explicit VertexStreams(const std::vector<Vertex>& vertices)
+		{
+			reserve(vertices.size());
+			for (const Vertex& vertex : vertices)
+			{
+				push_back(vertex);
+			}
+		}
 
-	struct Mesh
-	{
-		std::vector<Vertex> vertices{};
-		std::vector<uint32_t> indices{};
-		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
+		std::vector<Vector3> positions{};
+		std::vector<ColorRGB> colors{};
+		std::vector<Vector2> uvs{};
+		std::vector<Vector3> normals{};
+		std::vector<Vector3> tangents{};
 
-		std::vector<Vertex_Out> vertices_out{};
-		Matrix worldMatrix{};
+		size_t size() const { return positions.size(); }
 
-		inline void RotateY(float angle)
+		void reserve(size_t size)
 		{
-			worldMatrix = Matrix::CreateRotationY(angle * TO_RADIANS) * worldMatrix;
+			positions.reserve(size);
+			colors.reserve(size);
+			uvs.reserve(size);
+			normals.reserve(size);
+			tangents.reserve(size);
 		}
 
-		inline void RotateX(float angle)
+		void clear()
 		{
-			worldMatrix = Matrix::CreateRotationX(angle * TO_RADIANS) * worldMatrix;
+			positions.clear();
+			colors.clear();
+			uvs.clear();
+			normals.clear();
+			tangents.clear();
 		}
 
-		inline void RotateZ(float angle)
+		void push_back(const Vertex& vertex)
 		{
-			worldMatrix = Matrix::CreateRotationZ(angle * TO_RADIANS) * worldMatrix;
+			positions.push_back(vertex.position);
+			colors.push_back(vertex.color);
+			uvs.push_back(vertex.uv);
+			normals.push_back(vertex.normal);
+			tangents.push_back(vertex.tangent);
 		}
+	};
+
+	// Output of the vertex stage (post-transform cache) in the same layout, one entry per mesh vertex of a drawn instance.
+	// Colors and uvs don't change, those are read from the mesh streams.
+	struct TransformedVertexStreams
+	{
+		std::vector<Vector4> positions{}; // x and y in pixels, z NDC depth, w view space depth
+		std::vector<Vector3> normals{};
+		std::vector<Vector3> tangents{};
+		std::vector<Vector3> viewDirections{};
+		std::vector<uint8_t> clipCodes{}; // Clipping::ClipCode bits
 
-		inline void Translate(float x, float y, float z)
+		size_t size() const { return positions.size(); }
+
+		void resize(size_t size)
 		{
-			worldMatrix = Matrix::CreateTranslation(x, y, z) * worldMatrix;
+			positions.resize(size);
+			normals.resize(size);
+			tangents.resize(size);
+			viewDirections.resize(size);
+			clipCodes.resize(size);
 		}
+	};
+
+	// Axis aligned, in the space of the positions it was calculated from
+	struct BoundingBox
+	{
+		Vector3 min{};
+		Vector3 max{};
+	};
+
+	struct BoundingSphere
+	{
+		Vector3 center{};
+		float radius{};
+	};
+
+	enum class PrimitiveTopology
+	{
+		TriangleList,
+		TriangleStrip
+	};
 
-		inline void Translate(const Vector3& v)
+	// Which triangles are skipped before rasterization, front faces are clockwise on screen like in Direct3D
+	enum class CullMode
+	{
+		None,
+		Back,
+		Front
+	};
+
+	struct Mesh
+	{
+		VertexStreams vertices{};
+		std::vector<uint32_t> indices{};
+		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
+		CullMode cullMode{ CullMode::Back };
+
+		// Object space, meshes outside the view are skipped with these, so call CalculateBounds whenever the positions change
+		BoundingBox boundingBox{};
+		BoundingSphere boundingSphere{};
+
+		inline void CalculateBounds()
 		{
-			worldMatrix = Matrix::CreateTranslation(v) * worldMatrix;
+			if (vertices.positions.empty())
+			{
+				boundingBox = BoundingBox{};
+				boundingSphere = BoundingSphere{};
+				return;
+			}
+
+			boundingBox = BoundingBox{ vertices.positions[0], vertices.positions[0] };
+			for (const Vector3& position : vertices.positions)
+			{
+				boundingBox.min = Vector3::Min(boundingBox.min, position);
+				boundingBox.max = Vector3::Max(boundingBox.max, position);
+			}
+
+			//around the center of the box, tighter than half its diagonal
+			boundingSphere = BoundingSphere{ (boundingBox.min + boundingBox.max) * 0.5f, 0.f };
+			for (const Vector3& position : vertices.positions)
+			{
+				boundingSphere.radius = std::max(boundingSphere.radius, (position - boundingSphere.center).SqrMagnitude());
+			}
+			boundingSphere.radius = sqrtf(boundingSphere.radius);
 		}
 	};
 }
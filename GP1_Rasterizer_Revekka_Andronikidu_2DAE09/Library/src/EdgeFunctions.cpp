@@ -0,0 +1,227 @@
+#include "EdgeFunctions.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DAE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows every intrinsic without changing the target of the whole file
+#define DAE_TARGET_AVX2
+#else
+#define DAE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace dae;
+
+TriangleEdges::TriangleEdges(const Vector2& v0, const Vector2& v1, const Vector2& v2) :
+	area{ Vector2::Cross(v1 - v0, v2 - v0) },
+	vertices{ v0, v1, v2 }
+{
+	for (int edge{}; edge < 3; ++edge)
+	{
+		const Vector2& origin{ vertices[(edge + 1) % 3] };
+		const Vector2 edgeVector{ vertices[(edge + 2) % 3] - origin };
+
+		stepX[edge] = -edgeVector.y / area;
+		stepY[edge] = edgeVector.x / area;
+	}
+}
+
+float TriangleEdges::Evaluate(int edge, float x, float y) const
+{
+	const Vector2& origin{ vertices[(edge + 1) % 3] };
+	const Vector2 edgeVector{ vertices[(edge + 2) % 3] - origin };
+
+	return Vector2::Cross(edgeVector, Vector2{ x, y } - origin) / area;
+}
+
+static uint32_t EvaluateRowScalar(const TriangleEdges& edges, int x, int y, float* pWeights0, float* pWeights1, float* pWeights2)
+{
+	float* pWeights[3]{ pWeights0, pWeights1, pWeights2 };
+	uint32_t mask{ (1u << EdgeFunctions::BlockWidth) - 1 };
+
+	for (int edge{}; edge < 3; ++edge)
+	{
+		const float start{ edges.Evaluate(edge, float(x) + 0.5f, float(y) + 0.5f) };
+		for (int lane{}; lane < EdgeFunctions::BlockWidth; ++lane)
+		{
+			const float weight{ start + edges.stepX[edge] * float(lane) };
+			pWeights[edge][lane] = weight;
+			if (!(weight >= 0.f))
+			{
+				mask &= ~(1u << lane);
+			}
+		}
+	}
+	return mask;
+}
+
+#ifdef DAE_X86
+// 2x 4 pixels, SSE2 is always there on x64
+static uint32_t EvaluateRowSSE(const TriangleEdges& edges, int x, int y, float* pWeights0, float* pWeights1, float* pWeights2)
+{
+	float* pWeights[3]{ pWeights0, pWeights1, pWeights2 };
+	const __m128 lanesLow{ _mm_setr_ps(0.f, 1.f, 2.f, 3.f) };
+	const __m128 lanesHigh{ _mm_setr_ps(4.f, 5.f, 6.f, 7.f) };
+	const __m128 zero{ _mm_setzero_ps() };
+
+	__m128 insideLow{ _mm_castsi128_ps(_mm_set1_epi32(-1)) };
+	__m128 insideHigh{ insideLow };
+
+	for (int edge{}; edge < 3; ++edge)
+	{
+		const __m128 start{ _mm_set1_ps(edges.Evaluate(edge, float(x) + 0.5f, float(y) + 0.5f)) };
+		const __m128 step{ _mm_set1_ps(edges.stepX[edge]) };
+
+		const __m128 weightsLow{ _mm_add_ps(start, _mm_mul_ps(step, lanesLow)) };
+		const __m128 weightsHigh{ _mm_add_ps(start, _mm_mul_ps(step, lanesHigh)) };
+		_mm_storeu_ps(pWeights[edge], weightsLow);
+		_mm_storeu_ps(pWeights[edge] + 4, weightsHigh);
+
+		insideLow = _mm_and_ps(insideLow, _mm_cmpge_ps(weightsLow, zero));
+		insideHigh = _mm_and_ps(insideHigh, _mm_cmpge_ps(weightsHigh, zero));
+	}
+
+	return static_cast<uint32_t>(_mm_movemask_ps(insideLow) | (_mm_movemask_ps(insideHigh) << 4));
+}
+
+// All 8 pixels in one register
+DAE_TARGET_AVX2 static uint32_t EvaluateRowAVX2(const TriangleEdges& edges, int x, int y, float* pWeights0, float* pWeights1, float* pWeights2)
+{
+	float* pWeights[3]{ pWeights0, pWeights1, pWeights2 };
+	const __m256 lanes{ _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f) };
+	const __m256 zero{ _mm256_setzero_ps() };
+
+	__m256 inside{ _mm256_castsi256_ps(_mm256_set1_epi32(-1)) };
+
+	for (int edge{}; edge < 3; ++edge)
+	{
+		const __m256 start{ _mm256_set1_ps(edges.Evaluate(edge, float(x) + 0.5f, float(y) + 0.5f)) };
+		const __m256 step{ _mm256_set1_ps(edges.stepX[edge]) };
+
+		//no fma, so every level rounds the same way and the image doesn't depend on the CPU
+		const __m256 weights{ _mm256_add_ps(start, _mm256_mul_ps(step, lanes)) };
+		_mm256_storeu_ps(pWeights[edge], weights);
+
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(weights, zero, _CMP_GE_OQ));
+	}
+
+	return static_cast<uint32_t>(_mm256_movemask_ps(inside));
+}
+#endif
+
+static SimdLevel DetectSimdLevel()
+{
+#ifdef DAE_X86
+#if defined(_MSC_VER)
+	int info[4]{};
+	__cpuid(info, 0);
+	const int maxLeaf{ info[0] };
+
+	__cpuid(info, 1);
+	const bool osUsesXSave{ (info[2] & (1 << 27)) != 0 };
+	const bool hasAVX{ (info[2] & (1 << 28)) != 0 };
+	// the OS has to save the ymm registers on a context switch
+	const bool osSavesYmm{ osUsesXSave && (_xgetbv(0) & 0x6) == 0x6 };
+
+	bool hasAVX2{ false };
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		hasAVX2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (hasAVX && hasAVX2 && osSavesYmm)
+	{
+		return SimdLevel::AVX2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return SimdLevel::AVX2;
+	}
+#endif
+	return SimdLevel::SSE;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+using EvaluateRowFunction = uint32_t(*)(const TriangleEdges&, int, int, float*, float*, float*);
+
+static EvaluateRowFunction GetEvaluateRowFunction(SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef DAE_X86
+	case SimdLevel::AVX2:
+		return &EvaluateRowAVX2;
+	case SimdLevel::SSE:
+		return &EvaluateRowSSE;
+#endif
+	default:
+		return &EvaluateRowScalar;
+	}
+}
+
+static const SimdLevel s_SupportedSimdLevel{ DetectSimdLevel() };
+static SimdLevel s_SimdLevel{ s_SupportedSimdLevel };
+static EvaluateRowFunction s_pEvaluateRow{ GetEvaluateRowFunction(s_SimdLevel) };
+
+BlockCoverage EdgeFunctions::ClassifyBlock(const TriangleEdges& edges, int minX, int minY, int maxX, int maxY)
+{
+	const float left{ float(minX) + 0.5f };
+	const float right{ float(maxX - 1) + 0.5f };
+	const float top{ float(minY) + 0.5f };
+	const float bottom{ float(maxY - 1) + 0.5f };
+
+	bool isInside{ true };
+	for (int edge{}; edge < 3; ++edge)
+	{
+		const float corners[4]
+		{
+			edges.Evaluate(edge, left, top),
+			edges.Evaluate(edge, right, top),
+			edges.Evaluate(edge, left, bottom),
+			edges.Evaluate(edge, right, bottom)
+		};
+
+		const int numInside{ (corners[0] >= 0.f) + (corners[1] >= 0.f) + (corners[2] >= 0.f) + (corners[3] >= 0.f) };
+		if (numInside == 0)
+		{
+			return BlockCoverage::Outside;
+		}
+		isInside &= numInside == 4;
+	}
+
+	return isInside ? BlockCoverage::Inside : BlockCoverage::Partial;
+}
+
+uint32_t EdgeFunctions::EvaluateRow(const TriangleEdges& edges, int x, int y, float* pWeights0, float* pWeights1, float* pWeights2)
+{
+	return s_pEvaluateRow(edges, x, y, pWeights0, pWeights1, pWeights2);
+}
+
+SimdLevel EdgeFunctions::GetSimdLevel()
+{
+	return s_SimdLevel;
+}
+
+SimdLevel EdgeFunctions::GetSupportedSimdLevel()
+{
+	return s_SupportedSimdLevel;
+}
+
+void EdgeFunctions::SetSimdLevel(SimdLevel level)
+{
+	//never go above what the CPU can run
+	if (static_cast<int>(level) > static_cast<int>(s_SupportedSimdLevel))
+	{
+		level = s_SupportedSimdLevel;
+	}
+
+	s_SimdLevel = level;
+	s_pEvaluateRow = GetEvaluateRowFunction(level);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include "Vector2.h"
+
+namespace dae
+{
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE,
+		AVX2
+	};
+
+	enum class BlockCoverage
+	{
+		Outside,
+		Partial,
+		Inside
+	};
+
+	// The three edge functions of a screen space triangle, divided by its area so they give the barycentric weights directly.
+	// weight_i(x, y) = weight_i(originX, originY) + stepX_i * (x - originX) + stepY_i * (y - originY)
+	struct TriangleEdges
+	{
+		TriangleEdges(const Vector2& v0, const Vector2& v1, const Vector2& v2);
+
+		float area{};
+		Vector2 vertices[3]{};
+		float stepX[3]{};
+		float stepY[3]{};
+
+		// Same formula as Vector2::Cross(V2 - V1, P - V1) / area, used to start every row without accumulating error
+		float Evaluate(int edge, float x, float y) const;
+	};
+
+	namespace EdgeFunctions
+	{
+		// Amount of pixels a single EvaluateRow call covers
+		constexpr int BlockWidth{ 8 };
+		// Rows per block in hierarchical rasterization, blocks are BlockWidth x BlockHeight
+		constexpr int BlockHeight{ 8 };
+
+		// Evaluates the pixel centers (x + 0.5 + i, y + 0.5) for i in [0, BlockWidth).
+		// Writes the barycentric weights per pixel and returns a bitmask of the pixels inside the triangle (edges included).
+		uint32_t EvaluateRow(const TriangleEdges& edges, int x, int y, float* pWeights0, float* pWeights1, float* pWeights2);
+
+		// Tests the pixel centers of the block [minX, maxX) x [minY, maxY) against the edges using only its corners.
+		// Edge functions are linear, so if one edge is negative in all corners no pixel is inside, if all are positive every pixel is.
+		BlockCoverage ClassifyBlock(const TriangleEdges& edges, int minX, int minY, int maxX, int maxY);
+
+		// Picked at startup from the instruction sets the CPU supports, can be lowered for comparisons
+		SimdLevel GetSimdLevel();
+		SimdLevel GetSupportedSimdLevel();
+		void SetSimdLevel(SimdLevel level);
+	}
+}
@@ -0,0 +1,61 @@
+#include "Frustum.h"
+
+using namespace dae;
+
+Frustum::Frustum(const Matrix& worldViewProjectionMatrix)
+{
+	// Row vectors, so clip[i] = dot((x, y, z, 1), column i) and every plane is a sum of columns
+	Vector4 columns[4]{};
+	for (int column{}; column < 4; ++column)
+	{
+		columns[column] = Vector4{ worldViewProjectionMatrix[0][column], worldViewProjectionMatrix[1][column], worldViewProjectionMatrix[2][column], worldViewProjectionMatrix[3][column] };
+	}
+
+	planes[Left] = columns[3] + columns[0];		// -w <= x
+	planes[Right] = columns[3] - columns[0];	// x <= w
+	planes[Bottom] = columns[3] + columns[1];	// -w <= y
+	planes[Top] = columns[3] - columns[1];		// y <= w
+	planes[Near] = columns[2];					// 0 <= z
+	planes[Far] = columns[3] - columns[2];		// z <= w
+
+	//normalized, so the sphere test can compare distances with the radius
+	for (Vector4& plane : planes)
+	{
+		const float length{ Vector3{ plane.x, plane.y, plane.z }.Magnitude() };
+		if (length > 0.f)
+		{
+			plane = plane * (1.f / length);
+		}
+	}
+}
+
+bool Frustum::IsOutside(const BoundingSphere& sphere) const
+{
+	for (const Vector4& plane : planes)
+	{
+		if (plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w < -sphere.radius)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Frustum::IsOutside(const BoundingBox& box) const
+{
+	for (const Vector4& plane : planes)
+	{
+		// The corner furthest along the normal, if even that one is behind the plane the whole box is
+		const Vector3 corner
+		{
+			plane.x >= 0.f ? box.max.x : box.min.x,
+			plane.y >= 0.f ? box.max.y : box.min.y,
+			plane.z >= 0.f ? box.max.z : box.min.z
+		};
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.f)
+		{
+			return true;
+		}
+	}
+	return false;
+}
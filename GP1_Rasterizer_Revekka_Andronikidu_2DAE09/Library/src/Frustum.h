@@ -0,0 +1,30 @@
+#pragma once
+#include "DataTypes.h"
+
+namespace dae
+{
+	/**
+	 * The six planes of a view frustum, taken straight from the columns of a (world) view projection matrix (Gribb and Hartmann).
+	 * Built from the world view projection matrix of a mesh the planes are in object space, so its bounds are tested without transforming them.
+	 * Both tests are conservative: a volume is only outside when it lies completely behind one plane.
+	 */
+	struct Frustum
+	{
+		explicit Frustum(const Matrix& worldViewProjectionMatrix);
+
+		enum Plane
+		{
+			Left,
+			Right,
+			Bottom,
+			Top,
+			Near,
+			Far,
+			PlaneCount
+		};
+		Vector4 planes[PlaneCount]{}; // xyz normal pointing inwards (normalized), w distance
+
+		bool IsOutside(const BoundingSphere& sphere) const;
+		bool IsOutside(const BoundingBox& box) const;
+	};
+}
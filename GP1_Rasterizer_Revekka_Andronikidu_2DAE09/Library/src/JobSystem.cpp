@@ -0,0 +1,159 @@
+#include "JobSystem.h"
+#include <algorithm>
+using namespace dae;
+
+static thread_local uint32_t s_ThreadIndex{ 0 };
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	m_Queues.reserve(workerCount);
+	for (uint32_t i{}; i < workerCount; ++i)
+	{
+		m_Queues.push_back(std::make_unique<JobQueue>());
+	}
+
+	//the creating thread is worker 0, only spawn the others
+	m_Threads.reserve(workerCount - 1);
+	for (uint32_t i{ 1 }; i < workerCount; ++i)
+	{
+		m_Threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock{ m_WakeMutex };
+		m_IsRunning = false;
+	}
+	m_WakeCondition.notify_all();
+
+	for (auto& thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+	return s_ThreadIndex;
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grainSize = std::max(grainSize, 1u);
+	const uint32_t numChunks{ (count + grainSize - 1) / grainSize };
+
+	//nothing to share, skip the queues
+	if (m_Queues.size() == 1 || numChunks == 1)
+	{
+		job(0, count);
+		return;
+	}
+
+	std::atomic<uint32_t> remaining{ numChunks };
+
+	//count them before they are queued, so a worker that grabs one early can't wrap the counter
+	{
+		std::lock_guard lock{ m_WakeMutex };
+		m_QueuedJobs += numChunks;
+	}
+
+	//deal the chunks out round robin, starting at the own queue so the caller has work right away
+	const uint32_t numQueues{ static_cast<uint32_t>(m_Queues.size()) };
+	const uint32_t callerIdx{ s_ThreadIndex < numQueues ? s_ThreadIndex : 0 };
+	for (uint32_t queueOffset{}; queueOffset < numQueues && queueOffset < numChunks; ++queueOffset)
+	{
+		JobQueue& queue{ *m_Queues[(callerIdx + queueOffset) % numQueues] };
+		std::lock_guard lock{ queue.mutex };
+		for (uint32_t chunk{ queueOffset }; chunk < numChunks; chunk += numQueues)
+		{
+			const uint32_t begin{ chunk * grainSize };
+			queue.jobs.push_back(Job{ &job, begin, std::min(begin + grainSize, count), &remaining });
+		}
+	}
+
+	m_WakeCondition.notify_all();
+
+	//help out until every chunk of this call is finished
+	Job ownJob{};
+	while (remaining.load(std::memory_order_acquire) > 0)
+	{
+		if (PopJob(callerIdx, ownJob))
+		{
+			Execute(ownJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIdx)
+{
+	s_ThreadIndex = threadIdx;
+
+	Job job{};
+	while (true)
+	{
+		if (PopJob(threadIdx, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock lock{ m_WakeMutex };
+		m_WakeCondition.wait(lock, [this]() { return !m_IsRunning || m_QueuedJobs > 0; });
+		if (!m_IsRunning)
+		{
+			return;
+		}
+	}
+}
+
+bool JobSystem::PopJob(uint32_t threadIdx, Job& job)
+{
+	const uint32_t numQueues{ static_cast<uint32_t>(m_Queues.size()) };
+
+	//own queue first (newest job, still warm in cache), then steal the oldest job of the others
+	for (uint32_t offset{}; offset < numQueues; ++offset)
+	{
+		JobQueue& queue{ *m_Queues[(threadIdx + offset) % numQueues] };
+		std::lock_guard lock{ queue.mutex };
+		if (queue.jobs.empty())
+		{
+			continue;
+		}
+
+		if (offset == 0)
+		{
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+		}
+		--m_QueuedJobs;
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	(*job.pFunction)(job.begin, job.end);
+	job.pRemaining->fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	/**
+	 * Small work-stealing job system on top of std::thread.
+	 * Every thread owns a queue, pops its own work from the back and steals from the front of the other queues when it runs dry.
+	 * The thread calling ParallelFor helps out until its jobs are done, so it counts as one of the workers.
+	 */
+	class JobSystem final
+	{
+	public:
+		// workerCount includes the calling thread, 0 uses every hardware thread
+		explicit JobSystem(uint32_t workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem(JobSystem&&) noexcept = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+		// Splits [0, count) in chunks of grainSize and runs job(begin, end) on them, returns when every chunk is done
+		void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& job);
+
+		uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Queues.size()); };
+		// 0 for the thread that created the job system, 1..workerCount-1 for the workers
+		static uint32_t GetThreadIndex();
+
+	private:
+		struct Job
+		{
+			const std::function<void(uint32_t, uint32_t)>* pFunction{ nullptr };
+			uint32_t begin{};
+			uint32_t end{};
+			std::atomic<uint32_t>* pRemaining{ nullptr };
+		};
+
+		struct JobQueue
+		{
+			std::mutex mutex{};
+			std::deque<Job> jobs{};
+		};
+
+		std::vector<std::unique_ptr<JobQueue>> m_Queues{};
+		std::vector<std::thread> m_Threads{};
+
+		std::mutex m_WakeMutex{};
+		std::condition_variable m_WakeCondition{};
+		std::atomic<uint32_t> m_QueuedJobs{ 0 };
+		std::atomic<bool> m_IsRunning{ true };
+
+		void WorkerLoop(uint32_t threadIdx);
+		bool PopJob(uint32_t threadIdx, Job& job);
+		static void Execute(const Job& job);
+	};
+}
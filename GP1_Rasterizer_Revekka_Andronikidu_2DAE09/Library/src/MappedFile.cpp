@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path)
+{
+	HANDLE fileHandle{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return;
+	m_pFileHandle = fileHandle;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(fileHandle, &size))
+		return;
+	m_Size = static_cast<size_t>(size.QuadPart);
+
+	//a mapping of 0 bytes can't be created
+	if (m_Size == 0)
+	{
+		m_IsOpen = true;
+		return;
+	}
+
+	HANDLE mappingHandle{ CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+	if (!mappingHandle)
+		return;
+	m_pMappingHandle = mappingHandle;
+
+	m_pData = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	m_IsOpen = m_pData != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_pMappingHandle) CloseHandle(m_pMappingHandle);
+	if (m_pFileHandle) CloseHandle(m_pFileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+	const int fileDescriptor{ open(path.c_str(), O_RDONLY) };
+	if (fileDescriptor < 0)
+		return;
+
+	struct stat fileStatus{};
+	if (fstat(fileDescriptor, &fileStatus) == 0)
+	{
+		m_Size = static_cast<size_t>(fileStatus.st_size);
+		if (m_Size == 0)
+		{
+			m_IsOpen = true;
+		}
+		else
+		{
+			void* pData{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) };
+			if (pData != MAP_FAILED)
+			{
+				madvise(pData, m_Size, MADV_SEQUENTIAL);
+				m_pData = static_cast<const char*>(pData);
+				m_IsOpen = true;
+			}
+		}
+	}
+
+	//the mapping stays valid without the descriptor
+	close(fileDescriptor);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData) munmap(const_cast<char*>(m_pData), m_Size);
+}
+
+#endif
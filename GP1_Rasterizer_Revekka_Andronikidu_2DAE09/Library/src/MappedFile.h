@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	// Read-only memory mapping of a whole file, the pages are only loaded when they are touched
+	class MappedFile final
+	{
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		// False if the file couldn't be opened or mapped, an empty file is open but has no data
+		bool IsOpen() const { return m_IsOpen; };
+		const char* GetData() const { return m_pData; };
+		size_t GetSize() const { return m_Size; };
+
+	private:
+		bool m_IsOpen{ false };
+		const char* m_pData{ nullptr };
+		size_t m_Size{};
+
+		void* m_pFileHandle{ nullptr };	// Windows only
+		void* m_pMappingHandle{ nullptr };	// Windows only
+	};
+}
@@ -0,0 +1,205 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace dae;
+
+namespace
+{
+	constexpr char Magic[4]{ 'D', 'M', 'S', 'H' };
+	constexpr uint64_t StreamAlignment{ 16 };
+
+	//the streams are written as they are in memory
+	static_assert(sizeof(Vector3) == 3 * sizeof(float) && sizeof(Vector2) == 2 * sizeof(float) && sizeof(ColorRGB) == 3 * sizeof(float));
+
+	enum Stream
+	{
+		Positions,
+		Colors,
+		UVs,
+		Normals,
+		Tangents,
+		Indices,
+		StreamCount
+	};
+
+	struct Header
+	{
+		char magic[4]{};
+		uint32_t version{};
+		uint32_t flags{};
+		uint32_t primitiveTopology{};
+		uint64_t sourceSize{};
+		int64_t sourceTime{};
+		uint64_t vertexCount{};
+		uint64_t indexCount{};
+		BoundingBox boundingBox{};
+		BoundingSphere boundingSphere{};
+		uint64_t streamOffsets[StreamCount]{}; // from the start of the file
+	};
+
+	// Size and modification time of the source, both 0 if it doesn't exist (then any cache for it is used)
+	void GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+	{
+		std::error_code error{};
+		size = std::filesystem::file_size(sourcePath, error);
+		if (error)
+		{
+			size = 0;
+			time = 0;
+			return;
+		}
+		time = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+	}
+
+	uint64_t GetStreamSize(const Header& header, int stream)
+	{
+		switch (stream)
+		{
+		case Positions:	return header.vertexCount * sizeof(Vector3);
+		case Colors:	return header.vertexCount * sizeof(ColorRGB);
+		case UVs:		return header.vertexCount * sizeof(Vector2);
+		case Normals:	return header.vertexCount * sizeof(Vector3);
+		case Tangents:	return header.vertexCount * sizeof(Vector3);
+		case Indices:	return header.indexCount * sizeof(uint32_t);
+		default:		return 0;
+		}
+	}
+
+	template<typename T>
+	void CopyStream(const char* pFile, const Header& header, int stream, std::vector<T>& destination)
+	{
+		destination.resize(GetStreamSize(header, stream) / sizeof(T));
+		if (!destination.empty())
+		{
+			std::memcpy(destination.data(), pFile + header.streamOffsets[stream], destination.size() * sizeof(T));
+		}
+	}
+}
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return std::filesystem::path{ sourcePath }.replace_extension(".mesh").string();
+}
+
+bool MeshCache::Load(const std::string& cachePath, const std::string& sourcePath, uint32_t flags, Mesh& mesh)
+{
+	const MappedFile file{ cachePath };
+	if (!file.IsOpen() || file.GetSize() < sizeof(Header))
+		return false;
+
+	Header header{};
+	std::memcpy(&header, file.GetData(), sizeof(Header));
+
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version || header.flags != flags)
+		return false;
+
+	uint64_t sourceSize{};
+	int64_t sourceTime{};
+	GetSourceStamp(sourcePath, sourceSize, sourceTime);
+	//without the source the cache is trusted, only the checks below guard it
+	if (sourceSize != 0 && (header.sourceSize != sourceSize || header.sourceTime != sourceTime))
+		return false;
+
+	//a truncated or broken file must never be read past its end
+	if (header.vertexCount > file.GetSize() || header.indexCount > file.GetSize() || header.primitiveTopology > static_cast<uint32_t>(PrimitiveTopology::TriangleStrip))
+		return false;
+	for (int stream{}; stream < StreamCount; ++stream)
+	{
+		const uint64_t streamSize{ GetStreamSize(header, stream) };
+		if (header.streamOffsets[stream] > file.GetSize() || streamSize > file.GetSize() - header.streamOffsets[stream])
+			return false;
+	}
+
+	//an index past the vertices would have the vertex stage and the binning read outside the streams
+	CopyStream(file.GetData(), header, Indices, mesh.indices);
+	for (const uint32_t index : mesh.indices)
+	{
+		if (index >= header.vertexCount)
+		{
+			mesh.indices.clear();
+			return false;
+		}
+	}
+
+	CopyStream(file.GetData(), header, Positions, mesh.vertices.positions);
+	CopyStream(file.GetData(), header, Colors, mesh.vertices.colors);
+	CopyStream(file.GetData(), header, UVs, mesh.vertices.uvs);
+	CopyStream(file.GetData(), header, Normals, mesh.vertices.normals);
+	CopyStream(file.GetData(), header, Tangents, mesh.vertices.tangents);
+
+	mesh.primitiveTopology = static_cast<PrimitiveTopology>(header.primitiveTopology);
+	mesh.boundingBox = header.boundingBox;
+	mesh.boundingSphere = header.boundingSphere;
+	return true;
+}
+
+bool MeshCache::Save(const std::string& cachePath, const std::string& sourcePath, uint32_t flags, const Mesh& mesh)
+{
+	Header header{};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.flags = flags;
+	header.primitiveTopology = static_cast<uint32_t>(mesh.primitiveTopology);
+	GetSourceStamp(sourcePath, header.sourceSize, header.sourceTime);
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	header.boundingBox = mesh.boundingBox;
+	header.boundingSphere = mesh.boundingSphere;
+
+	const void* streamData[StreamCount]
+	{
+		mesh.vertices.positions.data(),
+		mesh.vertices.colors.data(),
+		mesh.vertices.uvs.data(),
+		mesh.vertices.normals.data(),
+		mesh.vertices.tangents.data(),
+		mesh.indices.data()
+	};
+
+	uint64_t offset{ sizeof(Header) };
+	for (int stream{}; stream < StreamCount; ++stream)
+	{
+		offset = (offset + StreamAlignment - 1) / StreamAlignment * StreamAlignment;
+		header.streamOffsets[stream] = offset;
+		offset += GetStreamSize(header, stream);
+	}
+
+	//written under another name first, a run that stops halfway never leaves a broken cache behind
+	const std::string tempPath{ cachePath + ".tmp" };
+	bool isWritten{ false };
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		uint64_t position{ sizeof(Header) };
+		for (int stream{}; stream < StreamCount; ++stream)
+		{
+			const char padding[StreamAlignment]{};
+			file.write(padding, static_cast<std::streamsize>(header.streamOffsets[stream] - position));
+
+			const uint64_t streamSize{ GetStreamSize(header, stream) };
+			file.write(static_cast<const char*>(streamData[stream]), static_cast<std::streamsize>(streamSize));
+			position = header.streamOffsets[stream] + streamSize;
+		}
+
+		isWritten = static_cast<bool>(file);
+	}
+
+	std::error_code error{};
+	if (isWritten)
+	{
+		std::filesystem::rename(tempPath, cachePath, error);
+	}
+	if (!isWritten || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
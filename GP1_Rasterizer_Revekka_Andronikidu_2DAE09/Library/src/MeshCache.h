@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	/**
+	 * Binary copy of a parsed mesh next to its source file, so later runs skip parsing, deduplication and tangents.
+	 * Layout: a versioned header followed by the position, color, uv, normal, tangent and index streams, each 16 byte aligned.
+	 * The file is memory mapped and every stream is copied into the mesh with a single memcpy.
+	 * A cache is stale when the version, the flags or the size and modification time of the source file don't match.
+	 * Without the source file there is no stamp to check and the cache is trusted, only its bounds and indices are validated.
+	 */
+	namespace MeshCache
+	{
+		constexpr uint32_t Version{ 4 };
+
+		// What the cached data was made with, a cache is only used for the same flags
+		enum Flags : uint32_t
+		{
+			FlippedAxisAndWinding = 1 << 0,
+			OptimizedVertexOrder = 1 << 1
+		};
+
+		// sourcePath.obj -> sourcePath.mesh
+		std::string GetCachePath(const std::string& sourcePath);
+
+		// Fills the vertices, indices, topology and bounds of the mesh, false if there is no cache or it is stale or broken
+		bool Load(const std::string& cachePath, const std::string& sourcePath, uint32_t flags, Mesh& mesh);
+		// False if the file couldn't be written, the mesh is still fine then
+		bool Save(const std::string& cachePath, const std::string& sourcePath, uint32_t flags, const Mesh& mesh);
+	}
+}
@@ -0,0 +1,416 @@
+#include "ObjParser.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+
+using namespace dae;
+
+namespace
+{
+	// 0 based indices into the attribute arrays of the whole file, -1 when the corner doesn't have the attribute
+	struct FaceCorner
+	{
+		int64_t position{ -1 };
+		int64_t uv{ -1 };
+		int64_t normal{ -1 };
+	};
+
+	// A range of whole lines, parsed by one job
+	struct Chunk
+	{
+		const char* pBegin{};
+		const char* pEnd{};
+
+		//counted in the first pass, so every chunk knows where its attributes go before the second one
+		size_t numPositions{};
+		size_t numUVs{};
+		size_t numNormals{};
+		size_t firstPosition{};
+		size_t firstUV{};
+		size_t firstNormal{};
+
+		std::vector<FaceCorner> corners{}; // 3 per triangle, in file order
+		bool isValid{ true };
+	};
+
+	// Position, uv and normal of a face corner, compared bit for bit so the comparison and the hash always agree
+	struct VertexKey
+	{
+		explicit VertexKey(const Vertex& vertex) :
+			bits
+			{
+				std::bit_cast<uint32_t>(vertex.position.x), std::bit_cast<uint32_t>(vertex.position.y), std::bit_cast<uint32_t>(vertex.position.z),
+				std::bit_cast<uint32_t>(vertex.uv.x), std::bit_cast<uint32_t>(vertex.uv.y),
+				std::bit_cast<uint32_t>(vertex.normal.x), std::bit_cast<uint32_t>(vertex.normal.y), std::bit_cast<uint32_t>(vertex.normal.z)
+			}
+		{
+		}
+
+		uint32_t bits[8];
+
+		bool operator==(const VertexKey& other) const = default;
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			//FNV-1a over the words
+			uint64_t hash{ 14695981039346656037ull };
+			for (const uint32_t bits : key.bits)
+			{
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	const char* SkipSpaces(const char* pChar, const char* pEnd)
+	{
+		while (pChar < pEnd && (*pChar == ' ' || *pChar == '\t' || *pChar == '\r'))
+		{
+			++pChar;
+		}
+		return pChar;
+	}
+
+	const char* FindLineEnd(const char* pChar, const char* pEnd)
+	{
+		const char* pNewLine{ static_cast<const char*>(std::memchr(pChar, '\n', pEnd - pChar)) };
+		return pNewLine ? pNewLine : pEnd;
+	}
+
+	bool IsSpace(char character)
+	{
+		return character == ' ' || character == '\t';
+	}
+
+	// What a line declares, from its first word
+	enum class LineType
+	{
+		Position,
+		UV,
+		Normal,
+		Face,
+		Other
+	};
+
+	// pChar points at the first character of the line, is moved past the keyword
+	LineType ReadLineType(const char*& pChar, const char* pLineEnd)
+	{
+		pChar = SkipSpaces(pChar, pLineEnd);
+		const size_t length{ static_cast<size_t>(pLineEnd - pChar) };
+
+		if (length >= 2 && pChar[0] == 'v' && IsSpace(pChar[1])) { pChar += 2; return LineType::Position; }
+		if (length >= 3 && pChar[0] == 'v' && pChar[1] == 't' && IsSpace(pChar[2])) { pChar += 3; return LineType::UV; }
+		if (length >= 3 && pChar[0] == 'v' && pChar[1] == 'n' && IsSpace(pChar[2])) { pChar += 3; return LineType::Normal; }
+		if (length >= 2 && pChar[0] == 'f' && IsSpace(pChar[1])) { pChar += 2; return LineType::Face; }
+		return LineType::Other;
+	}
+
+	// Missing or unreadable numbers are left at 0
+	const char* ReadFloat(const char* pChar, const char* pLineEnd, float& value)
+	{
+		pChar = SkipSpaces(pChar, pLineEnd);
+		if (pChar < pLineEnd && *pChar == '+') ++pChar; //from_chars doesn't take a plus sign
+
+		value = 0.f;
+		const std::from_chars_result result{ std::from_chars(pChar, pLineEnd, value) };
+		return result.ec == std::errc{} ? result.ptr : pChar;
+	}
+
+	// OBJ indices start at 1, negative ones count back from the last attribute declared before the face. -1 if missing or invalid
+	const char* ReadIndex(const char* pChar, const char* pLineEnd, size_t numDeclared, int64_t& index)
+	{
+		int64_t objIndex{};
+		const std::from_chars_result result{ std::from_chars(pChar, pLineEnd, objIndex) };
+		if (result.ec != std::errc{})
+		{
+			index = -1;
+			return pChar;
+		}
+
+		index = objIndex > 0 ? objIndex - 1 : static_cast<int64_t>(numDeclared) + objIndex;
+		return result.ptr;
+	}
+
+	void CountAttributes(Chunk& chunk)
+	{
+		for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd;)
+		{
+			const char* pLineEnd{ FindLineEnd(pLine, chunk.pEnd) };
+			switch (ReadLineType(pLine, pLineEnd))
+			{
+			case LineType::Position: ++chunk.numPositions; break;
+			case LineType::UV: ++chunk.numUVs; break;
+			case LineType::Normal: ++chunk.numNormals; break;
+			default: break;
+			}
+			pLine = pLineEnd + 1;
+		}
+	}
+
+	void ParseChunk(Chunk& chunk, std::vector<Vector3>& positions, std::vector<Vector2>& UVs, std::vector<Vector3>& normals)
+	{
+		size_t positionIdx{ chunk.firstPosition };
+		size_t uvIdx{ chunk.firstUV };
+		size_t normalIdx{ chunk.firstNormal };
+
+		std::vector<FaceCorner> polygon{};
+
+		for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd;)
+		{
+			const char* pLineEnd{ FindLineEnd(pLine, chunk.pEnd) };
+			const char* pChar{ pLine };
+
+			switch (ReadLineType(pChar, pLineEnd))
+			{
+			case LineType::Position:
+			{
+				Vector3& position{ positions[positionIdx++] };
+				pChar = ReadFloat(pChar, pLineEnd, position.x);
+				pChar = ReadFloat(pChar, pLineEnd, position.y);
+				ReadFloat(pChar, pLineEnd, position.z);
+			}
+			break;
+			case LineType::UV:
+			{
+				float u, v;
+				pChar = ReadFloat(pChar, pLineEnd, u);
+				ReadFloat(pChar, pLineEnd, v);
+				UVs[uvIdx++] = Vector2{ u, 1 - v };
+			}
+			break;
+			case LineType::Normal:
+			{
+				Vector3& normal{ normals[normalIdx++] };
+				pChar = ReadFloat(pChar, pLineEnd, normal.x);
+				pChar = ReadFloat(pChar, pLineEnd, normal.y);
+				ReadFloat(pChar, pLineEnd, normal.z);
+			}
+			break;
+			case LineType::Face:
+			{
+				polygon.clear();
+				for (pChar = SkipSpaces(pChar, pLineEnd); pChar < pLineEnd; pChar = SkipSpaces(pChar, pLineEnd))
+				{
+					FaceCorner corner{};
+					pChar = ReadIndex(pChar, pLineEnd, positionIdx, corner.position);
+					if (pChar < pLineEnd && *pChar == '/')
+					{
+						++pChar;
+						if (pChar < pLineEnd && *pChar != '/')
+						{
+							pChar = ReadIndex(pChar, pLineEnd, uvIdx, corner.uv);
+						}
+						if (pChar < pLineEnd && *pChar == '/')
+						{
+							++pChar;
+							pChar = ReadIndex(pChar, pLineEnd, normalIdx, corner.normal);
+						}
+					}
+
+					//anything else ends the face
+					if (corner.position < 0 || (pChar < pLineEnd && !IsSpace(*pChar) && *pChar != '\r'))
+					{
+						if (corner.position < 0) chunk.isValid = false;
+						break;
+					}
+					polygon.push_back(corner);
+				}
+
+				//fan around the first corner
+				for (size_t cornerIdx{ 2 }; cornerIdx < polygon.size(); ++cornerIdx)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[cornerIdx - 1]);
+					chunk.corners.push_back(polygon[cornerIdx]);
+				}
+			}
+			break;
+			default:
+				break;
+			}
+
+			pLine = pLineEnd + 1;
+		}
+	}
+
+	bool IsInRange(int64_t index, size_t size)
+	{
+		return index >= 0 && static_cast<size_t>(index) < size;
+	}
+}
+
+bool ObjParser::Parse(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding, JobSystem* pJobSystem)
+{
+	const MappedFile file{ path };
+	if (!file.IsOpen())
+		return false;
+
+	vertices.clear();
+	indices.clear();
+
+	const char* pData{ file.GetData() };
+	const size_t size{ file.GetSize() };
+
+	//split on line boundaries, a line never belongs to two chunks
+	const size_t numChunks{ pJobSystem ? std::max<size_t>(size / ParallelChunkSize, 1) : 1 };
+	std::vector<Chunk> chunks(numChunks);
+	const char* pChunkBegin{ pData };
+	for (size_t chunkIdx{}; chunkIdx < numChunks; ++chunkIdx)
+	{
+		const char* pChunkEnd{ pData + size };
+		if (chunkIdx + 1 < numChunks)
+		{
+			const char* pSplit{ std::max(pData + size * (chunkIdx + 1) / numChunks, pChunkBegin) };
+			pChunkEnd = std::min(FindLineEnd(pSplit, pData + size) + 1, pData + size);
+		}
+		chunks[chunkIdx].pBegin = pChunkBegin;
+		chunks[chunkIdx].pEnd = pChunkEnd;
+		pChunkBegin = pChunkEnd;
+	}
+
+	const auto ForEachChunk = [&](const std::function<void(Chunk&)>& function)
+		{
+			if (numChunks == 1)
+			{
+				function(chunks[0]);
+				return;
+			}
+			pJobSystem->ParallelFor(static_cast<uint32_t>(numChunks), 1, [&](uint32_t firstChunk, uint32_t lastChunk)
+				{
+					for (uint32_t chunkIdx{ firstChunk }; chunkIdx < lastChunk; ++chunkIdx)
+					{
+						function(chunks[chunkIdx]);
+					}
+				});
+		};
+
+	ForEachChunk(CountAttributes);
+
+	for (size_t chunkIdx{ 1 }; chunkIdx < numChunks; ++chunkIdx)
+	{
+		const Chunk& previous{ chunks[chunkIdx - 1] };
+		chunks[chunkIdx].firstPosition = previous.firstPosition + previous.numPositions;
+		chunks[chunkIdx].firstUV = previous.firstUV + previous.numUVs;
+		chunks[chunkIdx].firstNormal = previous.firstNormal + previous.numNormals;
+	}
+	std::vector<Vector3> positions(chunks.back().firstPosition + chunks.back().numPositions);
+	std::vector<Vector2> UVs(chunks.back().firstUV + chunks.back().numUVs);
+	std::vector<Vector3> normals(chunks.back().firstNormal + chunks.back().numNormals);
+
+	ForEachChunk([&](Chunk& chunk) { ParseChunk(chunk, positions, UVs, normals); });
+
+	//corners to vertices, in file order so the result is the same for any amount of chunks
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexToIndex{};
+	for (const Chunk& chunk : chunks)
+	{
+		if (!chunk.isValid)
+			return false;
+
+		for (size_t cornerIdx{}; cornerIdx < chunk.corners.size(); cornerIdx += 3)
+		{
+			uint32_t tempIndices[3];
+			for (size_t iFace = 0; iFace < 3; iFace++)
+			{
+				const FaceCorner& corner{ chunk.corners[cornerIdx + iFace] };
+				if (!IsInRange(corner.position, positions.size())
+					|| (corner.uv >= 0 && !IsInRange(corner.uv, UVs.size()))
+					|| (corner.normal >= 0 && !IsInRange(corner.normal, normals.size())))
+				{
+					return false;
+				}
+
+				Vertex vertex{};
+				vertex.position = positions[corner.position];
+				if (corner.uv >= 0) vertex.uv = UVs[corner.uv];
+				if (corner.normal >= 0) vertex.normal = normals[corner.normal];
+
+				// Only the first corner with these values becomes a new vertex, exporters often repeat the same normal or uv under another index
+				const auto [it, isNewVertex] { vertexToIndex.try_emplace(VertexKey{ vertex }, uint32_t(vertices.size())) };
+				if (isNewVertex)
+				{
+					vertices.push_back(vertex);
+				}
+				tempIndices[iFace] = it->second;
+			}
+
+			indices.push_back(tempIndices[0]);
+			if (flipAxisAndWinding)
+			{
+				indices.push_back(tempIndices[2]);
+				indices.push_back(tempIndices[1]);
+			}
+			else
+			{
+				indices.push_back(tempIndices[1]);
+				indices.push_back(tempIndices[2]);
+			}
+		}
+	}
+
+	//Cheap Tangent Calculations
+	for (uint32_t i = 0; i < indices.size(); i += 3)
+	{
+		uint32_t index0 = indices[i];
+		uint32_t index1 = indices[size_t(i) + 1];
+		uint32_t index2 = indices[size_t(i) + 2];
+
+		const Vector3& p0 = vertices[index0].position;
+		const Vector3& p1 = vertices[index1].position;
+		const Vector3& p2 = vertices[index2].position;
+		const Vector2& uv0 = vertices[index0].uv;
+		const Vector2& uv1 = vertices[index1].uv;
+		const Vector2& uv2 = vertices[index2].uv;
+
+		const Vector3 edge0 = p1 - p0;
+		const Vector3 edge1 = p2 - p0;
+		const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
+		const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
+		const float uvArea = Vector2::Cross(diffX, diffY);
+
+		//no uv direction to follow, and since vertices are shared the inf/NaN would spread to every triangle around it
+		if (std::abs(uvArea) < 1e-12f) continue;
+		float r = 1.f / uvArea;
+
+		Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
+		vertices[index0].tangent += tangent;
+		vertices[index1].tangent += tangent;
+		vertices[index2].tangent += tangent;
+	}
+
+	//Fix the tangents per vertex now because we accumulated
+	for (auto& v : vertices)
+	{
+		//an OBJ without vn lines leaves the normal at zero, there is nothing to reject against then
+		const bool hasNormal{ v.normal.SqrMagnitude() >= 1e-12f };
+		if (hasNormal)
+		{
+			v.tangent = Vector3::Reject(v.tangent, v.normal);
+		}
+		if (v.tangent.SqrMagnitude() < 1e-12f)
+		{
+			//only degenerate uvs around this vertex, any direction in the surface will do
+			const Vector3& axis{ std::abs(v.normal.x) < 0.9f ? Vector3::UnitX : Vector3::UnitY };
+			v.tangent = hasNormal ? Vector3::Cross(v.normal, axis) : Vector3::UnitX;
+		}
+		v.tangent.Normalize();
+
+		if (flipAxisAndWinding)
+		{
+			v.position.z *= -1.f;
+			v.normal.z *= -1.f;
+			v.tangent.z *= -1.f;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	class JobSystem;
+
+	/**
+	 * Wavefront OBJ loader working directly on a memory mapped file, numbers are read with std::from_chars so no token is ever copied into a string.
+	 * Supports v, vt, vn and f (v, v/vt, v//vn and v/vt/vn corners, negative indices, polygons are split into fans), everything else is skipped.
+	 * With a job system, files above ParallelChunkSize are split on line boundaries and the chunks are parsed in parallel, the result doesn't depend on it.
+	 */
+	namespace ObjParser
+	{
+		constexpr size_t ParallelChunkSize{ 256 * 1024 }; // bytes
+
+		// Face corners with the same position, uv and normal share one vertex, tangents are accumulated per vertex.
+		// Returns false if the file can't be opened or a face uses an index that doesn't exist
+		bool Parse(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true, JobSystem* pJobSystem = nullptr);
+	}
+}
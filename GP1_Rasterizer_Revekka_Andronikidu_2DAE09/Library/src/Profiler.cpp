@@ -0,0 +1,241 @@
+#include "Profiler.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+using namespace dae;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+	constexpr uint32_t MaxThreads{ 64 };
+	constexpr uint32_t EventsPerThread{ 1 << 16 };
+	constexpr uint32_t FrameHistorySize{ 256 };
+
+	struct ZoneEvent
+	{
+		ProfileZone zone{};
+		int64_t startNs{};
+		int64_t durationNs{};
+	};
+
+	// Only ever written by its own thread, aligned so two threads never share a cache line
+	struct alignas(64) ThreadSlot
+	{
+		std::vector<ZoneEvent> events{}; // ring buffer, allocated by the first zone of the thread
+		uint64_t numEvents{};
+		int64_t zoneNs[ProfileZoneCount]{};
+		uint64_t counters[ProfileCounterCount]{};
+		bool isUsed{ false };
+	};
+
+	struct FrameRecord
+	{
+		int64_t startNs{};
+		FrameProfile profile{};
+	};
+
+	const Clock::time_point s_Epoch{ Clock::now() };
+	std::atomic<bool> s_IsEnabled{ false };
+
+	ThreadSlot s_ThreadSlots[MaxThreads]{};
+
+	uint64_t s_FrameIdx{};
+	Clock::time_point s_FrameStart{};
+	FrameProfile s_LastFrame{};
+	FrameRecord s_FrameHistory[FrameHistorySize]{};
+
+	int64_t ToNanoseconds(Clock::time_point timePoint)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint - s_Epoch).count();
+	}
+
+	ThreadSlot* GetThreadSlot()
+	{
+		const uint32_t threadIdx{ JobSystem::GetThreadIndex() };
+		return threadIdx < MaxThreads ? &s_ThreadSlots[threadIdx] : nullptr;
+	}
+}
+
+void Profiler::SetEnabled(bool isEnabled)
+{
+	s_IsEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()
+{
+	return s_IsEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::BeginFrame()
+{
+	if (!IsEnabled()) return;
+
+	for (ThreadSlot& slot : s_ThreadSlots)
+	{
+		std::fill(std::begin(slot.zoneNs), std::end(slot.zoneNs), 0);
+		std::fill(std::begin(slot.counters), std::end(slot.counters), 0);
+	}
+	s_FrameStart = Clock::now();
+}
+
+void Profiler::EndFrame()
+{
+	if (!IsEnabled()) return;
+
+	const Clock::time_point frameEnd{ Clock::now() };
+
+	FrameProfile profile{};
+	profile.frameIdx = s_FrameIdx;
+	profile.frameMs = std::chrono::duration<float, std::milli>(frameEnd - s_FrameStart).count();
+
+	for (const ThreadSlot& slot : s_ThreadSlots)
+	{
+		if (!slot.isUsed) continue;
+
+		std::vector<float>& threadZoneMs{ profile.threadZoneMs.emplace_back(ProfileZoneCount) };
+		for (int zoneIdx{}; zoneIdx < ProfileZoneCount; ++zoneIdx)
+		{
+			threadZoneMs[zoneIdx] = slot.zoneNs[zoneIdx] / 1'000'000.f;
+			profile.zoneMs[zoneIdx] += threadZoneMs[zoneIdx];
+		}
+		for (int counterIdx{}; counterIdx < ProfileCounterCount; ++counterIdx)
+		{
+			profile.counters[counterIdx] += slot.counters[counterIdx];
+		}
+	}
+
+	FrameRecord& record{ s_FrameHistory[s_FrameIdx % FrameHistorySize] };
+	record.startNs = ToNanoseconds(s_FrameStart);
+	record.profile = profile;
+
+	s_LastFrame = std::move(profile);
+	++s_FrameIdx;
+}
+
+const FrameProfile& Profiler::GetLastFrame()
+{
+	return s_LastFrame;
+}
+
+void Profiler::AddCount(ProfileCounter counter, uint64_t amount)
+{
+	if (!IsEnabled()) return;
+
+	if (ThreadSlot* pSlot{ GetThreadSlot() })
+	{
+		pSlot->counters[static_cast<int>(counter)] += amount;
+		pSlot->isUsed = true;
+	}
+}
+
+void Profiler::RecordZone(ProfileZone zone, Clock::time_point start, Clock::time_point end)
+{
+	ThreadSlot* pSlot{ GetThreadSlot() };
+	if (!pSlot) return;
+
+	const int64_t startNs{ ToNanoseconds(start) };
+	const int64_t durationNs{ ToNanoseconds(end) - startNs };
+	pSlot->zoneNs[static_cast<int>(zone)] += durationNs;
+
+	if (pSlot->events.empty())
+	{
+		pSlot->events.resize(EventsPerThread);
+	}
+
+	pSlot->events[pSlot->numEvents % EventsPerThread] = ZoneEvent{ zone, startNs, durationNs };
+	++pSlot->numEvents;
+
+	pSlot->isUsed = true;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	//timestamps in the trace format are microseconds
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Rasterizer\"}}";
+
+	for (uint32_t threadIdx{}; threadIdx < MaxThreads; ++threadIdx)
+	{
+		const ThreadSlot& slot{ s_ThreadSlots[threadIdx] };
+		if (!slot.isUsed) continue;
+
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadIdx
+			<< ",\"args\":{\"name\":\"" << (threadIdx == 0 ? "Main" : "Worker ") ;
+		if (threadIdx != 0) file << threadIdx;
+		file << "\"}}";
+
+		//oldest first, once the ring is full that is the one that is overwritten next
+		const uint64_t numStored{ std::min<uint64_t>(slot.numEvents, EventsPerThread) };
+		const uint64_t firstEvent{ slot.numEvents - numStored };
+		for (uint64_t eventIdx{ firstEvent }; eventIdx < slot.numEvents; ++eventIdx)
+		{
+			const ZoneEvent& event{ slot.events[eventIdx % EventsPerThread] };
+			file << ",\n{\"name\":\"" << GetZoneName(event.zone) << "\",\"cat\":\"renderer\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadIdx
+				<< ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0 << "}";
+		}
+	}
+
+	const uint64_t numFrames{ std::min<uint64_t>(s_FrameIdx, FrameHistorySize) };
+	for (uint64_t frameIdx{ s_FrameIdx - numFrames }; frameIdx < s_FrameIdx; ++frameIdx)
+	{
+		const FrameRecord& record{ s_FrameHistory[frameIdx % FrameHistorySize] };
+
+		file << ",\n{\"name\":\"Frame " << record.profile.frameIdx << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+			<< ",\"ts\":" << record.startNs / 1000.0 << ",\"dur\":" << record.profile.frameMs * 1000.0 << "}";
+
+		for (int counterIdx{}; counterIdx < ProfileCounterCount; ++counterIdx)
+		{
+			file << ",\n{\"name\":\"" << GetCounterName(static_cast<ProfileCounter>(counterIdx)) << "\",\"ph\":\"C\",\"pid\":0"
+				<< ",\"ts\":" << record.startNs / 1000.0 << ",\"args\":{\"value\":" << record.profile.counters[counterIdx] << "}}";
+		}
+
+		//totals per zone
+		file << ",\n{\"name\":\"Zone ms\",\"ph\":\"C\",\"pid\":0,\"ts\":" << record.startNs / 1000.0 << ",\"args\":{";
+		for (int zoneIdx{}; zoneIdx < ProfileZoneCount; ++zoneIdx)
+		{
+			file << (zoneIdx ? "," : "") << "\"" << GetZoneName(static_cast<ProfileZone>(zoneIdx)) << "\":" << record.profile.zoneMs[zoneIdx];
+		}
+		file << "}}";
+	}
+
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
+
+const char* Profiler::GetZoneName(ProfileZone zone)
+{
+	switch (zone)
+	{
+	case ProfileZone::Clear:			return "Clear";
+	case ProfileZone::VertexTransform:	return "VertexTransform";
+	case ProfileZone::Clipping:			return "Clipping";
+	case ProfileZone::NDCtoScreenSpace:	return "NDCtoScreenSpace";
+	case ProfileZone::Rasterization:	return "Rasterization";
+	case ProfileZone::PixelShading:		return "PixelShading";
+	case ProfileZone::Blit:				return "Blit";
+	default:							return "Unknown";
+	}
+}
+
+const char* Profiler::GetCounterName(ProfileCounter counter)
+{
+	switch (counter)
+	{
+	case ProfileCounter::InstancesIn:		return "InstancesIn";
+	case ProfileCounter::InstancesCulled:	return "InstancesCulled";
+	case ProfileCounter::TrianglesIn:		return "TrianglesIn";
+	case ProfileCounter::TrianglesCulled:	return "TrianglesCulled";
+	case ProfileCounter::TrianglesClipped:	return "TrianglesClipped";
+	case ProfileCounter::FragmentsTested:	return "FragmentsTested";
+	case ProfileCounter::FragmentsPassed:	return "FragmentsPassed";
+	case ProfileCounter::FragmentsShaded:	return "FragmentsShaded";
+	default:								return "Unknown";
+	}
+}
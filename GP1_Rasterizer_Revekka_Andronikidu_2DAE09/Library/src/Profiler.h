@@ -0,0 +1,108 @@
+#pragma once
+
+//Standard includes
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	enum class ProfileZone
+	{
+		Clear,
+		VertexTransform,
+		Clipping,
+		NDCtoScreenSpace,
+		Rasterization,
+		PixelShading,
+		Blit,
+		END
+	};
+
+	enum class ProfileCounter
+	{
+		InstancesIn,
+		InstancesCulled,
+		TrianglesIn,
+		TrianglesCulled,
+		TrianglesClipped,
+		FragmentsTested,
+		FragmentsPassed,
+		FragmentsShaded,
+		END
+	};
+
+	constexpr int ProfileZoneCount{ static_cast<int>(ProfileZone::END) };
+	constexpr int ProfileCounterCount{ static_cast<int>(ProfileCounter::END) };
+
+	// Everything that was measured between BeginFrame and EndFrame
+	struct FrameProfile
+	{
+		uint64_t frameIdx{};
+		float frameMs{};
+		float zoneMs[ProfileZoneCount]{};	// summed over all threads
+		uint64_t counters[ProfileCounterCount]{};
+		std::vector<std::vector<float>> threadZoneMs{};	// [thread][zone]
+	};
+
+	/**
+	 * Instrumentation for the hot paths of the renderer.
+	 * Every thread of the job system writes its zones and counters to its own slot (JobSystem::GetThreadIndex), so recording never locks.
+	 * EndFrame sums the slots into a FrameProfile, the zones themselves stay in a ring buffer per thread that can be written as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+	 * Disabled by default, then a zone costs a single branch.
+	 */
+	namespace Profiler
+	{
+		void SetEnabled(bool isEnabled);
+		bool IsEnabled();
+
+		// Only call these from the thread that renders, while no jobs are running
+		void BeginFrame();
+		void EndFrame();
+		const FrameProfile& GetLastFrame();
+
+		void AddCount(ProfileCounter counter, uint64_t amount);
+
+		// Writes the zones still in the ring buffers and the counters of the recent frames, returns false if the file couldn't be written
+		bool WriteChromeTrace(const std::string& path);
+
+		const char* GetZoneName(ProfileZone zone);
+		const char* GetCounterName(ProfileCounter counter);
+
+		void RecordZone(ProfileZone zone, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	}
+
+	// Measures its own lifetime as the given zone
+	class ProfileScope final
+	{
+	public:
+		explicit ProfileScope(ProfileZone zone) :
+			m_Zone{ zone },
+			m_IsRecording{ Profiler::IsEnabled() }
+		{
+			if (m_IsRecording)
+			{
+				m_Start = std::chrono::steady_clock::now();
+			}
+		}
+
+		~ProfileScope()
+		{
+			if (m_IsRecording)
+			{
+				Profiler::RecordZone(m_Zone, m_Start, std::chrono::steady_clock::now());
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope(ProfileScope&&) noexcept = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+		ProfileScope& operator=(ProfileScope&&) noexcept = delete;
+
+	private:
+		ProfileZone m_Zone;
+		bool m_IsRecording;
+		std::chrono::steady_clock::time_point m_Start{};
+	};
+}
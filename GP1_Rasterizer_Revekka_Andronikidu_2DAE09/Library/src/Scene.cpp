@@ -0,0 +1,80 @@
+#include "Scene.h"
+
+using namespace dae;
+
+Scene::~Scene()
+{
+	for (Texture* pTexture : m_pTextures)
+	{
+		delete pTexture;
+	}
+}
+
+uint32_t Scene::AddMesh(Mesh&& mesh)
+{
+	m_Meshes.push_back(std::move(mesh));
+	return static_cast<uint32_t>(m_Meshes.size() - 1);
+}
+
+uint32_t Scene::AddMaterial(const Material& material)
+{
+	m_Materials.push_back(material);
+	return static_cast<uint32_t>(m_Materials.size() - 1);
+}
+
+uint32_t Scene::LoadMaterial(const std::string& diffusePath, const std::string& normalPath, const std::string& specularPath, const std::string& glossinessPath, float shininess)
+{
+	const auto LoadOrDefault = [](const std::string& path, uint32_t defaultTexel)
+		{
+			Texture* pTexture{ Texture::LoadFromFile(path) };
+			return pTexture ? pTexture : Texture::CreateSolid(defaultTexel);
+		};
+
+	//the maps are only needed until they are packed
+	Texture* pDiffuse{ LoadOrDefault(diffusePath, 0xFFFFFFFF) };
+	Texture* pNormal{ LoadOrDefault(normalPath, 0xFFFF8080) };
+	Texture* pSpecular{ LoadOrDefault(specularPath, 0xFF000000) };
+	Texture* pGlossiness{ LoadOrDefault(glossinessPath, 0xFF000000) };
+
+	Material material{};
+	material.pDiffuseGlossiness = Texture::CreatePacked(*pDiffuse, *pGlossiness);
+	material.pNormalSpecular = Texture::CreatePacked(*pNormal, *pSpecular);
+	material.shininess = shininess;
+
+	delete pDiffuse;
+	delete pNormal;
+	delete pSpecular;
+	delete pGlossiness;
+
+	m_pTextures.push_back(material.pDiffuseGlossiness);
+	m_pTextures.push_back(material.pNormalSpecular);
+	return AddMaterial(material);
+}
+
+uint32_t Scene::AddInstance(uint32_t meshIdx, uint32_t materialIdx, const Matrix& worldMatrix)
+{
+	m_Instances.push_back(MeshInstance{ meshIdx, materialIdx, worldMatrix });
+	return static_cast<uint32_t>(m_Instances.size() - 1);
+}
+
+Texture* Scene::LoadTexture(const std::string& path)
+{
+	Texture* pTexture{ Texture::LoadFromFile(path) };
+	if (pTexture)
+	{
+		m_pTextures.push_back(pTexture);
+	}
+	return pTexture;
+}
+
+void Scene::SetTextureLayout(TextureLayout layout)
+{
+	//only what the shading samples, a texture shared by two materials is already in the layout the second time
+	for (const Material& material : m_Materials)
+	{
+		for (Texture* pTexture : { material.pDiffuseGlossiness, material.pNormalSpecular })
+		{
+			if (pTexture) pTexture->SetLayout(layout);
+		}
+	}
+}
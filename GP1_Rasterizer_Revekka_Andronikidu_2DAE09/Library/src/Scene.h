@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Texture.h"
+
+namespace dae
+{
+	// Two packed textures instead of four maps, two fetches per fragment. Scene::LoadMaterial builds them.
+	// Textures are owned by the scene that loaded them
+	struct Material
+	{
+		Texture* pDiffuseGlossiness{}; // diffuse in rgb, glossiness in a
+		Texture* pNormalSpecular{}; // tangent space normal in rgb, specular intensity in a
+		float shininess{ 25.f };
+	};
+
+	// One draw of a mesh of the scene with one of its materials
+	struct MeshInstance
+	{
+		uint32_t meshIdx{};
+		uint32_t materialIdx{};
+		Matrix worldMatrix{};
+
+		inline void RotateY(float angle)
+		{
+			worldMatrix = Matrix::CreateRotationY(angle * TO_RADIANS) * worldMatrix;
+		}
+
+		inline void Translate(const Vector3& v)
+		{
+			worldMatrix = Matrix::CreateTranslation(v) * worldMatrix;
+		}
+	};
+
+	/**
+	 * Everything the renderer draws. Meshes and materials are stored once and shared, an instance only adds a world matrix,
+	 * so a crowd of the same vehicle costs one copy of its vertices. Every visible instance is transformed on its own every frame.
+	 * Meshes, materials and instances are referred to by index, the vectors may grow while the scene is built.
+	 */
+	class Scene final
+	{
+	public:
+		Scene() = default;
+		~Scene();
+
+		Scene(const Scene&) = delete;
+		Scene(Scene&&) noexcept = delete;
+		Scene& operator=(const Scene&) = delete;
+		Scene& operator=(Scene&&) noexcept = delete;
+
+		uint32_t AddMesh(Mesh&& mesh);
+		uint32_t AddMaterial(const Material& material);
+		// Loads the four maps and packs them, only the packed textures are kept. A map that can't be loaded is replaced by a neutral texel:
+		// white diffuse, a flat normal, no specular and no glossiness
+		uint32_t LoadMaterial(const std::string& diffusePath, const std::string& normalPath, const std::string& specularPath, const std::string& glossinessPath, float shininess = 25.f);
+		uint32_t AddInstance(uint32_t meshIdx, uint32_t materialIdx, const Matrix& worldMatrix = {});
+		// Owned by the scene from now on, nullptr if it couldn't be loaded
+		Texture* LoadTexture(const std::string& path);
+		// Of the packed textures of every material, the ones the shading samples
+		void SetTextureLayout(TextureLayout layout);
+
+		Mesh& GetMesh(uint32_t meshIdx) { return m_Meshes[meshIdx]; };
+		const Mesh& GetMesh(uint32_t meshIdx) const { return m_Meshes[meshIdx]; };
+		const Material& GetMaterial(uint32_t materialIdx) const { return m_Materials[materialIdx]; };
+		MeshInstance& GetInstance(uint32_t instanceIdx) { return m_Instances[instanceIdx]; };
+		const std::vector<MeshInstance>& GetInstances() const { return m_Instances; };
+
+		// Meshes and materials stay
+		void ClearInstances() { m_Instances.clear(); };
+
+	private:
+		std::vector<Mesh> m_Meshes{};
+		std::vector<Material> m_Materials{};
+		std::vector<MeshInstance> m_Instances{};
+		std::vector<Texture*> m_pTextures{};
+	};
+}
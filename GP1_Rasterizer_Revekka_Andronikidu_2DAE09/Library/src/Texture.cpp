@@ -1,55 +1,269 @@
 #include "Texture.h"
-#include "Vector2.h"
 #include <SDL_image.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <iostream>
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	// Weighted sum of packed texels, the weights are 8 bit fixed point and add up to 256.
+	// Red and blue are filtered with one multiply, green and alpha with another: a channel times a weight fits in 16 bits, so they never run into each other
+	template<int numTexels>
+	static uint32_t BlendTexels(const uint32_t(&texels)[numTexels], const uint32_t(&weights)[numTexels])
 	{
+		uint32_t redBlue{};
+		uint32_t greenAlpha{};
+		for (int texelIdx{}; texelIdx < numTexels; ++texelIdx)
+		{
+			redBlue += (texels[texelIdx] & 0x00FF00FF) * weights[texelIdx];
+			greenAlpha += ((texels[texelIdx] >> 8) & 0x00FF00FF) * weights[texelIdx];
+		}
+		return ((redBlue >> 8) & 0x00FF00FF) | (greenAlpha & 0xFF00FF00);
 	}
 
-	Texture::~Texture()
+	// Straight from the exponent and mantissa bits, so exact at powers of two and linear in between. Close enough to pick a mip level
+	static float FastLog2(float value)
 	{
-		if (m_pSurface)
-		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
-		}
+		return static_cast<float>(std::bit_cast<uint32_t>(value)) * (1.f / (1 << 23)) - 127.f;
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	Texture::Texture(int width, int height, std::vector<uint32_t>&& texels) :
+		m_Width{ width },
+		m_Height{ height },
+		m_Texels{ std::move(texels) },
+		m_IsPowerOfTwo{ std::has_single_bit(static_cast<uint32_t>(width)) && std::has_single_bit(static_cast<uint32_t>(height)) }
+	{
+		BuildMipChain();
+	}
+
+	Texture* Texture::LoadFromFile(const std::string& path, TextureLayout layout)
 	{
 		SDL_Surface* pLoadedSurface = IMG_Load(path.c_str());
 		if (pLoadedSurface == nullptr)
 		{
 			std::cout << "TextureFromFile: SDL Error when calling IMG_Load: " << SDL_GetError() << std::endl;
+			return nullptr;
 		}
-		return new Texture(pLoadedSurface);	
+
+		// Whatever the file was, converted once to the one layout Sample reads.
+		// ABGR8888 is a packed format, so red is the lowest byte of the uint32_t on any endianness
+		SDL_Surface* pConvertedSurface = SDL_ConvertSurfaceFormat(pLoadedSurface, SDL_PIXELFORMAT_ABGR8888, 0);
+		SDL_FreeSurface(pLoadedSurface);
+		if (pConvertedSurface == nullptr)
+		{
+			std::cout << "TextureFromFile: SDL Error when calling SDL_ConvertSurfaceFormat: " << SDL_GetError() << std::endl;
+			return nullptr;
+		}
+
+		const int width{ pConvertedSurface->w };
+		const int height{ pConvertedSurface->h };
+		std::vector<uint32_t> texels(static_cast<size_t>(width) * height);
+
+		SDL_LockSurface(pConvertedSurface);
+		for (int y{}; y < height; ++y)
+		{
+			//rows of a surface can be padded
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pConvertedSurface->pixels) + static_cast<size_t>(y) * pConvertedSurface->pitch };
+			std::memcpy(texels.data() + static_cast<size_t>(y) * width, pRow, width * sizeof(uint32_t));
+		}
+		SDL_UnlockSurface(pConvertedSurface);
+		SDL_FreeSurface(pConvertedSurface);
+
+		Texture* pTexture{ new Texture(width, height, std::move(texels)) };
+		pTexture->SetLayout(layout);
+		return pTexture;
 	}
 
-	ColorRGB Texture::Sample(const Vector2& uv) const
+	Texture* Texture::CreatePacked(const Texture& rgbSource, const Texture& alphaSource)
 	{
-		SDL_Color rgb{};
-		
-		//if (uv.x > 1 || uv.x < -1)
-		//	return {};
-		//if (uv.y > 1 || uv.y < -1)
-		//	return {};
+		const int width{ std::max(rgbSource.m_Width, alphaSource.m_Width) };
+		const int height{ std::max(rgbSource.m_Height, alphaSource.m_Height) };
+		std::vector<uint32_t> texels(static_cast<size_t>(width) * height);
 
-		//Vector2 uvNormalized = uv.Normalized();
-		Uint32 u = uv.x * m_pSurface->w;
-		Uint32 v = uv.y * m_pSurface->h;
+		for (int y{}; y < height; ++y)
+		{
+			for (int x{}; x < width; ++x)
+			{
+				//both are read at the center of the texel, which is exactly that texel in a source of the same size
+				const Vector2 uv{ (x + 0.5f) / width, (y + 0.5f) / height };
+				const uint32_t alphaTexel{ alphaSource.FetchTexel(uv) };
+				const uint32_t average{ ((alphaTexel & 0xFF) + ((alphaTexel >> 8) & 0xFF) + ((alphaTexel >> 16) & 0xFF) + 1) / 3 };
 
-		//Sample the correct data for the given uv
-		Uint32 index{ u + v * static_cast<Uint32>(m_pSurface->w) };
-		Uint32 p = m_pSurfacePixels[index];
-		SDL_GetRGB(p, m_pSurface->format, &rgb.r, &rgb.g, &rgb.b);
+				const uint32_t rgbTexel{ rgbSource.FetchTexel(uv) };
+				texels[x + static_cast<size_t>(y) * width] = (rgbTexel & 0x00FFFFFF) | (average << 24);
+			}
+		}
+
+		Texture* pTexture{ new Texture(width, height, std::move(texels)) };
+		pTexture->SetLayout(rgbSource.m_Layout);
+		pTexture->SetAddressMode(rgbSource.m_AddressMode);
+		return pTexture;
+	}
+
+	Texture* Texture::CreateSolid(uint32_t texel)
+	{
+		return new Texture(1, 1, std::vector<uint32_t>{ texel });
+	}
+
+	void Texture::SetLayout(TextureLayout layout)
+	{
+		if (layout == m_Layout) return;
+
+		std::vector<uint32_t> texels{};
+		std::vector<MipLevel> mipLevels{ m_MipLevels };
+		for (size_t levelIdx{}; levelIdx < mipLevels.size(); ++levelIdx)
+		{
+			const MipLevel& source{ m_MipLevels[levelIdx] };
+			MipLevel& level{ mipLevels[levelIdx] };
+			level.offset = texels.size();
+			texels.resize(level.offset + GetLevelSize(level, layout));
+
+			for (int y{}; y < level.height; ++y)
+			{
+				for (int x{}; x < level.width; ++x)
+				{
+					texels[GetTexelIndex(level, layout, x, y)] = m_Texels[GetTexelIndex(source, m_Layout, x, y)];
+				}
+			}
+		}
+
+		m_Texels = std::move(texels);
+		m_MipLevels = std::move(mipLevels);
+		m_Layout = layout;
+	}
+
+	size_t Texture::GetLevelSize(const MipLevel& level, TextureLayout layout)
+	{
+		if (layout == TextureLayout::Linear)
+		{
+			return static_cast<size_t>(level.width) * level.height;
+		}
+
+		const int tilesPerColumn{ (level.height + m_TileMask) >> m_TileShift };
+		return static_cast<size_t>(level.tilesPerRow) * tilesPerColumn << (2 * m_TileShift);
+	}
+
+	void Texture::BuildMipChain()
+	{
+		//built row by row, the constructor leaves the texels in the linear layout
+		const auto GetTilesPerRow = [](int width) { return (width + m_TileMask) >> m_TileShift; };
+		m_MipLevels.push_back(MipLevel{ m_Width, m_Height, GetTilesPerRow(m_Width), 0 });
+
+		// Every level is a 2x2 box filter of the one above it. An odd size rounds down, the last column or row is then averaged with itself
+		while (m_MipLevels.back().width > 1 || m_MipLevels.back().height > 1)
+		{
+			const MipLevel source{ m_MipLevels.back() };
+			const int width{ std::max(source.width / 2, 1) };
+			const MipLevel level{ width, std::max(source.height / 2, 1), GetTilesPerRow(width), m_Texels.size() };
+			m_Texels.resize(level.offset + static_cast<size_t>(level.width) * level.height);
+
+			for (int y{}; y < level.height; ++y)
+			{
+				const int y0{ std::min(y * 2, source.height - 1) };
+				const int y1{ std::min(y * 2 + 1, source.height - 1) };
+				for (int x{}; x < level.width; ++x)
+				{
+					const int x0{ std::min(x * 2, source.width - 1) };
+					const int x1{ std::min(x * 2 + 1, source.width - 1) };
+					const uint32_t texels[4]
+					{
+						m_Texels[source.offset + x0 + static_cast<size_t>(y0) * source.width],
+						m_Texels[source.offset + x1 + static_cast<size_t>(y0) * source.width],
+						m_Texels[source.offset + x0 + static_cast<size_t>(y1) * source.width],
+						m_Texels[source.offset + x1 + static_cast<size_t>(y1) * source.width]
+					};
+
+					uint32_t average{};
+					for (int shift{}; shift < 32; shift += 8)
+					{
+						uint32_t sum{ 2 }; //rounds to nearest
+						for (const uint32_t texel : texels)
+						{
+							sum += (texel >> shift) & 0xFF;
+						}
+						average |= (sum / 4) << shift;
+					}
+					m_Texels[level.offset + x + static_cast<size_t>(y) * level.width] = average;
+				}
+			}
+
+			m_MipLevels.push_back(level);
+		}
+	}
+
+	uint32_t Texture::SampleFiltered(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter) const
+	{
+		// The level where one pixel step covers one texel along the axis that changes fastest
+		const float texelDdxX{ uvDdx.x * m_Width };
+		const float texelDdxY{ uvDdx.y * m_Height };
+		const float texelDdyX{ uvDdy.x * m_Width };
+		const float texelDdyY{ uvDdy.y * m_Height };
+		const float maxSqrFootprint{ std::max(texelDdxX * texelDdxX + texelDdxY * texelDdxY, texelDdyX * texelDdyX + texelDdyY * texelDdyY) };
+		const float maxLevel{ static_cast<float>(m_MipLevels.size() - 1) };
+
+		//0.5 * log2 of the squared length is log2 of the length, magnified surfaces stay on the full size level
+		const float lod{ std::clamp(0.5f * FastLog2(maxSqrFootprint), 0.f, maxLevel) };
+
+		//the address mode is picked once here, everything below is specialized for it
+		switch (m_AddressMode)
+		{
+		case TextureAddressMode::Clamp:
+			return SampleMipmapped<TextureAddressMode::Clamp>(uv, lod, filter);
+		case TextureAddressMode::Mirror:
+			return SampleMipmapped<TextureAddressMode::Mirror>(uv, lod, filter);
+		default:
+			return SampleMipmapped<TextureAddressMode::Wrap>(uv, lod, filter);
+		}
+	}
+
+	template<TextureAddressMode addressMode>
+	uint32_t Texture::SampleMipmapped(const Vector2& uv, float lod, TextureFilter filter) const
+	{
+		if (filter == TextureFilter::Bilinear)
+		{
+			return SampleBilinear<addressMode>(uv, static_cast<int>(lod + 0.5f));
+		}
+
+		const int levelIdx{ static_cast<int>(lod) };
+		const uint32_t blend{ static_cast<uint32_t>((lod - levelIdx) * 256.f) };
+		if (blend == 0) return SampleBilinear<addressMode>(uv, levelIdx);
+
+		const uint32_t texels[2]{ SampleBilinear<addressMode>(uv, levelIdx), SampleBilinear<addressMode>(uv, levelIdx + 1) };
+		return BlendTexels(texels, { 256 - blend, blend });
+	}
+
+	template<TextureAddressMode addressMode>
+	uint32_t Texture::SampleBilinear(const Vector2& uv, int levelIdx) const
+	{
+		const MipLevel& level{ m_MipLevels[levelIdx] };
+
+		// In texels with 8 fractional bits. Texel centers are at .5, so the four nearest ones start half a texel to the top left.
+		// Fits an int for uvs within a few thousand repeats of a 1024 texture
+		const int x{ FloorToInt(uv.x * level.width * 256.f) - 128 };
+		const int y{ FloorToInt(uv.y * level.height * 256.f) - 128 };
+		const uint32_t fractionX{ static_cast<uint32_t>(x & 0xFF) };
+		const uint32_t fractionY{ static_cast<uint32_t>(y & 0xFF) };
+
+		//the right and bottom neighbour can be on the other side of an edge as well
+		const int x0{ AddressTexel<addressMode>(x >> 8, level.width, m_IsPowerOfTwo) };
+		const int y0{ AddressTexel<addressMode>(y >> 8, level.height, m_IsPowerOfTwo) };
+		const int x1{ AddressTexel<addressMode>((x >> 8) + 1, level.width, m_IsPowerOfTwo) };
+		const int y1{ AddressTexel<addressMode>((y >> 8) + 1, level.height, m_IsPowerOfTwo) };
+
+		const uint32_t texels[4]
+		{
+			m_Texels[GetTexelIndex(level, m_Layout, x0, y0)],
+			m_Texels[GetTexelIndex(level, m_Layout, x1, y0)],
+			m_Texels[GetTexelIndex(level, m_Layout, x0, y1)],
+			m_Texels[GetTexelIndex(level, m_Layout, x1, y1)]
+		};
 
-		//change color from range 0,255 to 0,1
-		ColorRGB rgb2{ rgb.r, rgb.g, rgb.b };
-		return rgb2 / 255;
+		//rounded down, the last weight takes what is left so they still add up to 256
+		const uint32_t weightTopLeft{ ((256 - fractionX) * (256 - fractionY)) >> 8 };
+		const uint32_t weightTopRight{ (fractionX * (256 - fractionY)) >> 8 };
+		const uint32_t weightBottomLeft{ ((256 - fractionX) * fractionY) >> 8 };
+		const uint32_t weightBottomRight{ 256 - weightTopLeft - weightTopRight - weightBottomLeft };
+		return BlendTexels(texels, { weightTopLeft, weightTopRight, weightBottomLeft, weightBottomRight });
 	}
-}
\ No newline at end of file
+}
@@ -1,24 +1,200 @@
 #pragma once
-#include <SDL_surface.h>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "Vector2.h"
 
 namespace dae
 {
-	struct Vector2;
+	enum class TextureFilter
+	{
+		Point,		// nearest texel of the full size level, derivatives are ignored
+		Bilinear,	// 2x2 texels of the nearest mip level
+		Trilinear,	// 2x2 texels of the two nearest mip levels, blended
+		END
+	};
+
+	// What a uv outside [0, 1] reads
+	enum class TextureAddressMode
+	{
+		Wrap,	// the texture repeats
+		Clamp,	// the edge texels stretch out
+		Mirror	// the texture repeats, every other copy flipped
+	};
+
+	// How the texels of a mip level are ordered in memory
+	enum class TextureLayout
+	{
+		Linear,	// row by row
+		Tiled	// 4x4 texel tiles of 64 bytes (one cache line), the tiles row by row. A 2x2 filter footprint or a step along v mostly stays in one line
+	};
 
 	class Texture
 	{
 	public:
-		~Texture();
+		// Builds the whole mip chain down to 1x1
+		static Texture* LoadFromFile(const std::string& path, TextureLayout layout = TextureLayout::Linear);
+		// rgb of one texture with the average of the rgb of another in alpha, so a material reads both with one fetch.
+		// A grayscale map comes through unchanged, a colored one as its average. The sources can differ in size, the result is as large as the larger one
+		// and has the layout and address mode of rgbSource
+		static Texture* CreatePacked(const Texture& rgbSource, const Texture& alphaSource);
+		// 1x1, to stand in for a map that couldn't be loaded
+		static Texture* CreateSolid(uint32_t texel);
+
+		// One texel, no filtering. Inline so the fetches per fragment don't cost a call each
+		inline ColorRGB Sample(const Vector2& uv) const
+		{
+			return Unpack(FetchTexel(uv));
+		}
+
+		// uvDdx and uvDdy are how much the uv changes one pixel to the right and one pixel down, the mip level is picked from those
+		inline ColorRGB Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter) const
+		{
+			return Unpack(SamplePacked(uv, uvDdx, uvDdy, filter));
+		}
+
+		// Same, alpha included
+		inline ColorRGB Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter, float& alpha) const
+		{
+			const uint32_t texel{ SamplePacked(uv, uvDdx, uvDdy, filter) };
+			alpha = (texel >> 24) * m_ToUnitRange;
+			return Unpack(texel);
+		}
 
-		static Texture* LoadFromFile(const std::string& path);
-		ColorRGB Sample(const Vector2& uv) const;
+		int GetWidth() const { return m_Width; };
+		int GetHeight() const { return m_Height; };
+		int GetMipCount() const { return static_cast<int>(m_MipLevels.size()); };
+
+		// Reorders the texels of every level, sampling gives the same result either way
+		void SetLayout(TextureLayout layout);
+		TextureLayout GetLayout() const { return m_Layout; };
+
+		void SetAddressMode(TextureAddressMode addressMode) { m_AddressMode = addressMode; };
+		TextureAddressMode GetAddressMode() const { return m_AddressMode; };
 
 	private:
-		Texture(SDL_Surface* pSurface);
+		struct MipLevel
+		{
+			int width{};
+			int height{};
+			int tilesPerRow{}; // rounded up, the tiles on the right and bottom edge are padded
+			size_t offset{}; // of its first texel in m_Texels
+		};
+
+		static constexpr int m_TileShift{ 2 }; // 4x4 texels per tile
+		static constexpr int m_TileMask{ (1 << m_TileShift) - 1 };
+
+		static inline size_t GetTexelIndex(const MipLevel& level, TextureLayout layout, int x, int y)
+		{
+			if (layout == TextureLayout::Linear)
+			{
+				return level.offset + x + static_cast<size_t>(y) * level.width;
+			}
+
+			const size_t tileIdx{ static_cast<size_t>(x >> m_TileShift) + static_cast<size_t>(y >> m_TileShift) * level.tilesPerRow };
+			return level.offset + (tileIdx << (2 * m_TileShift)) + ((y & m_TileMask) << m_TileShift) + (x & m_TileMask);
+		}
+		static size_t GetLevelSize(const MipLevel& level, TextureLayout layout);
+
+		Texture(int width, int height, std::vector<uint32_t>&& texels);
+
+		//change color from range 0,255 to 0,1
+		static constexpr float m_ToUnitRange{ 1.f / 255.f };
+
+		static inline ColorRGB Unpack(uint32_t texel)
+		{
+			return ColorRGB
+			{
+				(texel & 0xFF) * m_ToUnitRange,
+				((texel >> 8) & 0xFF) * m_ToUnitRange,
+				((texel >> 16) & 0xFF) * m_ToUnitRange
+			};
+		}
+
+		// A cast alone rounds negative coordinates the wrong way, and floor is a call without SSE4.1
+		static inline int FloorToInt(float value)
+		{
+			const int truncated{ static_cast<int>(value) };
+			return truncated - (value < static_cast<float>(truncated));
+		}
+
+		// Maps a texel coordinate from anywhere onto [0, size) without branching on the coordinate.
+		// Power of two sizes are masked, other sizes take a modulo. isPowerOfTwo is the same for every sample of a texture, so that branch is always predicted
+		template<TextureAddressMode addressMode>
+		static inline int AddressTexel(int coordinate, int size, bool isPowerOfTwo)
+		{
+			if constexpr (addressMode == TextureAddressMode::Clamp)
+			{
+				return std::clamp(coordinate, 0, size - 1);
+			}
+			else if constexpr (addressMode == TextureAddressMode::Wrap)
+			{
+				if (isPowerOfTwo) return coordinate & (size - 1);
+
+				//the remainder has the sign of the coordinate, negative ones move up one period
+				const int remainder{ coordinate % size };
+				return remainder + (size & (remainder >> 31));
+			}
+			else
+			{
+				if (isPowerOfTwo)
+				{
+					//every odd period is flipped, and for a power of two size - 1 - x is x ^ (size - 1)
+					const int flip{ -((coordinate >> std::countr_zero(static_cast<uint32_t>(size))) & 1) };
+					return (coordinate & (size - 1)) ^ (flip & (size - 1));
+				}
+
+				const int period{ 2 * size };
+				int remainder{ coordinate % period };
+				remainder += period & (remainder >> 31);
+				return std::min(remainder, period - 1 - remainder);
+			}
+		}
+
+		// Nearest texel of the full size level
+		template<TextureAddressMode addressMode>
+		inline uint32_t FetchTexel(const Vector2& uv) const
+		{
+			const int u{ AddressTexel<addressMode>(FloorToInt(uv.x * m_Width), m_Width, m_IsPowerOfTwo) };
+			const int v{ AddressTexel<addressMode>(FloorToInt(uv.y * m_Height), m_Height, m_IsPowerOfTwo) };
+			return m_Texels[GetTexelIndex(m_MipLevels[0], m_Layout, u, v)];
+		}
+
+		inline uint32_t FetchTexel(const Vector2& uv) const
+		{
+			switch (m_AddressMode)
+			{
+			case TextureAddressMode::Clamp:
+				return FetchTexel<TextureAddressMode::Clamp>(uv);
+			case TextureAddressMode::Mirror:
+				return FetchTexel<TextureAddressMode::Mirror>(uv);
+			default:
+				return FetchTexel<TextureAddressMode::Wrap>(uv);
+			}
+		}
+
+		inline uint32_t SamplePacked(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter) const
+		{
+			if (filter == TextureFilter::Point) return FetchTexel(uv);
+			return SampleFiltered(uv, uvDdx, uvDdy, filter);
+		}
+
+		void BuildMipChain();
+		uint32_t SampleFiltered(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter) const;
+		template<TextureAddressMode addressMode>
+		uint32_t SampleMipmapped(const Vector2& uv, float lod, TextureFilter filter) const;
+		template<TextureAddressMode addressMode>
+		uint32_t SampleBilinear(const Vector2& uv, int levelIdx) const; // packed like the texels
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		int m_Width{};
+		int m_Height{};
+		std::vector<uint32_t> m_Texels{}; // every mip level in m_Layout order, packed with red in the lowest byte. The full size level comes first
+		std::vector<MipLevel> m_MipLevels{};
+		TextureLayout m_Layout{ TextureLayout::Linear };
+		TextureAddressMode m_AddressMode{ TextureAddressMode::Wrap };
+		bool m_IsPowerOfTwo{}; // both sides, then every mip level is as well
 	};
-}
\ No newline at end of file
+}
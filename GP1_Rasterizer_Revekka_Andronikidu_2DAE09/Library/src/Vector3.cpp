@@ -1,5 +1,6 @@
 #include "Vector3.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "Vector4.h"
@@ -65,6 +66,16 @@ namespace dae {
 		};
 	}
 
+	Vector3 Vector3::Min(const Vector3& v1, const Vector3& v2)
+	{
+		return { std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z) };
+	}
+
+	Vector3 Vector3::Max(const Vector3& v1, const Vector3& v2)
+	{
+		return { std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z) };
+	}
+
 	Vector3 Vector3::Project(const Vector3& v1, const Vector3& v2)
 	{
 		return (v2 * (Dot(v1, v2) / Dot(v2, v2)));
@@ -0,0 +1,202 @@
+#include "VertexCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+namespace
+{
+	//weights from the original article
+	constexpr float CacheDecayPower{ 1.5f };
+	constexpr float LastTriangleScore{ 0.75f };
+	constexpr float ValenceBoostScale{ 2.f };
+	constexpr float ValenceBoostPower{ 0.5f };
+
+	// cachePosition is -1 when the vertex isn't in the cache
+	float CalculateVertexScore(int cachePosition, uint32_t numTrianglesLeft)
+	{
+		//nothing left to draw with this vertex
+		if (numTrianglesLeft == 0) return -1.f;
+
+		float score{};
+		if (cachePosition >= 0)
+		{
+			//the vertices of the triangle that was just emitted all get the same score, otherwise the order would favour one side
+			if (cachePosition < 3)
+			{
+				score = LastTriangleScore;
+			}
+			else
+			{
+				const float scaler{ 1.f / (VertexCache::CacheSize - 3) };
+				score = std::pow(1.f - (cachePosition - 3) * scaler, CacheDecayPower);
+			}
+		}
+
+		score += ValenceBoostScale * std::pow(static_cast<float>(numTrianglesLeft), -ValenceBoostPower);
+		return score;
+	}
+}
+
+void VertexCache::OptimizeTriangleOrder(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	const uint32_t numTriangles{ static_cast<uint32_t>(indices.size() / 3) };
+	if (numTriangles == 0) return;
+
+	//the triangles of every vertex in one array, the ones that are still left are kept at the front of each range
+	std::vector<uint32_t> numTrianglesLeft(vertexCount);
+	for (const uint32_t vertexIdx : indices)
+	{
+		++numTrianglesLeft[vertexIdx];
+	}
+
+	std::vector<uint32_t> firstTriangle(vertexCount + 1);
+	for (uint32_t vertexIdx{}; vertexIdx < vertexCount; ++vertexIdx)
+	{
+		firstTriangle[vertexIdx + 1] = firstTriangle[vertexIdx] + numTrianglesLeft[vertexIdx];
+	}
+
+	std::vector<uint32_t> vertexTriangles(numTriangles * 3);
+	{
+		std::vector<uint32_t> nextSlot(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (uint32_t triangleIdx{}; triangleIdx < numTriangles; ++triangleIdx)
+		{
+			for (uint32_t corner{}; corner < 3; ++corner)
+			{
+				vertexTriangles[nextSlot[indices[triangleIdx * 3 + corner]]++] = triangleIdx;
+			}
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t vertexIdx{}; vertexIdx < vertexCount; ++vertexIdx)
+	{
+		vertexScore[vertexIdx] = CalculateVertexScore(-1, numTrianglesLeft[vertexIdx]);
+	}
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<uint8_t> isEmitted(numTriangles);
+	uint32_t bestTriangle{};
+	for (uint32_t triangleIdx{}; triangleIdx < numTriangles; ++triangleIdx)
+	{
+		const uint32_t* pTriangle{ &indices[triangleIdx * 3] };
+		triangleScore[triangleIdx] = vertexScore[pTriangle[0]] + vertexScore[pTriangle[1]] + vertexScore[pTriangle[2]];
+		if (triangleScore[triangleIdx] > triangleScore[bestTriangle])
+		{
+			bestTriangle = triangleIdx;
+		}
+	}
+
+	std::vector<uint32_t> cache{};
+	std::vector<uint32_t> newCache{};
+	cache.reserve(CacheSize + 3);
+	newCache.reserve(CacheSize + 3);
+
+	std::vector<uint32_t> newIndices{};
+	newIndices.reserve(indices.size());
+	uint32_t firstNotEmitted{};
+
+	while (bestTriangle != UINT32_MAX)
+	{
+		isEmitted[bestTriangle] = true;
+		const uint32_t* pTriangle{ &indices[bestTriangle * 3] };
+
+		newCache.clear();
+		for (uint32_t corner{}; corner < 3; ++corner)
+		{
+			const uint32_t vertexIdx{ pTriangle[corner] };
+			newIndices.push_back(vertexIdx);
+			newCache.push_back(vertexIdx);
+
+			//move the triangle behind the ones that are left
+			uint32_t* pBegin{ &vertexTriangles[firstTriangle[vertexIdx]] };
+			uint32_t* pEnd{ pBegin + numTrianglesLeft[vertexIdx] };
+			std::iter_swap(std::find(pBegin, pEnd, bestTriangle), pEnd - 1);
+			--numTrianglesLeft[vertexIdx];
+		}
+
+		//the vertices of the triangle go to the front of the LRU cache, the rest moves back
+		for (const uint32_t vertexIdx : cache)
+		{
+			if (vertexIdx != pTriangle[0] && vertexIdx != pTriangle[1] && vertexIdx != pTriangle[2])
+			{
+				newCache.push_back(vertexIdx);
+			}
+		}
+
+		//rescore everything in the cache and what just fell out of it, their triangles change by the same amount
+		for (uint32_t position{}; position < newCache.size(); ++position)
+		{
+			const uint32_t vertexIdx{ newCache[position] };
+			cachePosition[vertexIdx] = position < CacheSize ? static_cast<int>(position) : -1;
+
+			const float score{ CalculateVertexScore(cachePosition[vertexIdx], numTrianglesLeft[vertexIdx]) };
+			const float scoreChange{ score - vertexScore[vertexIdx] };
+			vertexScore[vertexIdx] = score;
+
+			const uint32_t* pTriangles{ &vertexTriangles[firstTriangle[vertexIdx]] };
+			for (uint32_t triangleIdx{}; triangleIdx < numTrianglesLeft[vertexIdx]; ++triangleIdx)
+			{
+				triangleScore[pTriangles[triangleIdx]] += scoreChange;
+			}
+		}
+
+		if (newCache.size() > CacheSize)
+		{
+			newCache.resize(CacheSize);
+		}
+		std::swap(cache, newCache);
+
+		//the next triangle is the best one that uses a vertex in the cache
+		bestTriangle = UINT32_MAX;
+		float bestScore{ -1.f };
+		for (const uint32_t vertexIdx : cache)
+		{
+			const uint32_t* pTriangles{ &vertexTriangles[firstTriangle[vertexIdx]] };
+			for (uint32_t triangleIdx{}; triangleIdx < numTrianglesLeft[vertexIdx]; ++triangleIdx)
+			{
+				if (triangleScore[pTriangles[triangleIdx]] > bestScore)
+				{
+					bestScore = triangleScore[pTriangles[triangleIdx]];
+					bestTriangle = pTriangles[triangleIdx];
+				}
+			}
+		}
+
+		//nothing in the cache has triangles left, continue with the next piece of the mesh
+		if (bestTriangle == UINT32_MAX)
+		{
+			while (firstNotEmitted < numTriangles && isEmitted[firstNotEmitted])
+			{
+				++firstNotEmitted;
+			}
+			if (firstNotEmitted < numTriangles)
+			{
+				bestTriangle = firstNotEmitted;
+			}
+		}
+	}
+
+	indices = std::move(newIndices);
+}
+
+void VertexCache::OptimizeVertexOrder(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> newVertexIdx(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> newVertices{};
+	newVertices.reserve(vertices.size());
+
+	for (uint32_t& vertexIdx : indices)
+	{
+		if (newVertexIdx[vertexIdx] == UINT32_MAX)
+		{
+			newVertexIdx[vertexIdx] = static_cast<uint32_t>(newVertices.size());
+			newVertices.push_back(vertices[vertexIdx]);
+		}
+		vertexIdx = newVertexIdx[vertexIdx];
+	}
+
+	vertices = std::move(newVertices);
+}
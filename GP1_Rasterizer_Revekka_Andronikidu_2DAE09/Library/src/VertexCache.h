@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	/**
+	 * Reordering of indexed triangle lists, so vertices that are used together are also close together in memory.
+	 * The order of the triangles changes, so triangles with the exact same depth can resolve differently.
+	 */
+	namespace VertexCache
+	{
+		// Size of the LRU cache the triangle order is optimized for
+		constexpr uint32_t CacheSize{ 32 };
+
+		// Tom Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle whose vertices were used most recently,
+		// preferring vertices with few triangles left so no lonely triangles stay behind
+		void OptimizeTriangleOrder(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+		// Renumbers the vertices in the order the triangles first use them, vertices no triangle uses are dropped
+		void OptimizeVertexOrder(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	}
+}
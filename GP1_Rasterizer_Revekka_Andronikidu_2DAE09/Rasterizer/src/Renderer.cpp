@@ -9,26 +9,68 @@
 #include "Utils.h"
 #include <iostream>
 #include "BRDFs.h"
+#include "JobSystem.h"
+#include "EdgeFunctions.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "Clipping.h"
+#include "Frustum.h"
+#include "MeshCache.h"
+#include "VertexCache.h"
 //my includes
 #include <vector>
-#include <ppl.h>
+#include <bit>
+#include <chrono>
 
 using namespace dae;
 using namespace Utils;
 
-Renderer::Renderer(SDL_Window* pWindow) :
-	m_pWindow(pWindow)
+Renderer::Renderer(SDL_Window* pWindow, uint32_t workerCount) :
+	m_pWindow(pWindow),
+	m_pJobSystem(new JobSystem(workerCount))
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+
+	Initialize();
+	if (!LoadMesh("Resources/vehicle.obj"))
+	{
+		std::cout << "Could not load Resources/vehicle.obj\n";
+	}
+}
 
+Renderer::Renderer(int width, int height, uint32_t workerCount) :
+	m_Width(width),
+	m_Height(height),
+	m_pJobSystem(new JobSystem(workerCount))
+{
+	//no window and no front buffer, Render stops after filling the back buffer
+	//the vehicle stays empty until LoadMesh, whoever renders headless picks the mesh
+	Initialize();
+}
+
+void Renderer::Initialize()
+{
 	//Create Buffers
-	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
 	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
 	m_pDepthBufferPixels = new float[m_Width * m_Height];
 
+	//Screen tiles for binning
+	m_NumTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NumTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_TileBins.resize(m_NumTilesX * m_NumTilesY);
+
+	//Hierarchical depth
+	m_NumDepthBlocksX = (m_Width + EdgeFunctions::BlockWidth - 1) / EdgeFunctions::BlockWidth;
+	m_NumDepthBlocksY = (m_Height + EdgeFunctions::BlockHeight - 1) / EdgeFunctions::BlockHeight;
+	m_BlockMinDepth.resize(m_NumDepthBlocksX * m_NumDepthBlocksY);
+	m_BlockMaxDepth.resize(m_NumDepthBlocksX * m_NumDepthBlocksY);
+	m_TileMaxDepth.resize(m_NumTilesX * m_NumTilesY);
+
+	m_VisibilityBuffer.resize(m_Width * m_Height);
 
 
 	//Initialize Camera
@@ -36,10 +78,9 @@ Renderer::Renderer(SDL_Window* pWindow) :
 
 	m_AspectRatio = m_Width / float(m_Height);
 	
-	m_pDiffuseTexture = Texture::LoadFromFile("Resources/vehicle_diffuse.png");
-	m_pSpecularTexture = Texture::LoadFromFile("Resources/vehicle_specular.png");
-	m_pGlossinessTexture = Texture::LoadFromFile("Resources/vehicle_gloss.png");
-	m_pNormalTexture = Texture::LoadFromFile("Resources/vehicle_normal.png");
+	m_pScene = new Scene();
+
+	const uint32_t materialIdx{ m_pScene->LoadMaterial("Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png", "Resources/vehicle_gloss.png") };
 	
 
 	//meshes
@@ -64,22 +105,76 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	//	PrimitiveTopology::TriangleStrip,
 	//};
 
-	m_pMesh = new Mesh();
-	Utils::ParseOBJ("Resources/vehicle.obj", m_pMesh->vertices, m_pMesh->indices);
-	
-	m_pMesh->Translate(0.f, 0.f, 10.f);
-	m_pMesh->primitiveTopology = PrimitiveTopology::TriangleList;
-	
+	//an empty list draws nothing until LoadMesh fills it
+	Mesh vehicleMesh{};
+	vehicleMesh.primitiveTopology = PrimitiveTopology::TriangleList;
+	const uint32_t meshIdx{ m_pScene->AddMesh(std::move(vehicleMesh)) };
+	m_VehicleInstanceIdx = m_pScene->AddInstance(meshIdx, materialIdx, Matrix::CreateTranslation(m_MeshPosition));
+}
+
+bool Renderer::LoadMesh(const std::string& objPath, bool optimizeVertexOrder)
+{
+	Mesh mesh{};
+	if (!LoadMesh(objPath, mesh, optimizeVertexOrder))
+	{
+		return false;
+	}
+
+	m_pScene->GetMesh(m_pScene->GetInstance(m_VehicleInstanceIdx).meshIdx) = std::move(mesh);
+	return true;
+}
+
+bool Renderer::LoadMesh(const std::string& objPath, Mesh& mesh, bool optimizeVertexOrder) const
+{
+	const std::string cachePath{ MeshCache::GetCachePath(objPath) };
+	const uint32_t cacheFlags{ MeshCache::FlippedAxisAndWinding | (optimizeVertexOrder ? MeshCache::OptimizedVertexOrder : 0u) };
+	if (!MeshCache::Load(cachePath, objPath, cacheFlags, mesh))
+	{
+		std::vector<Vertex> vertices{};
+		if (!Utils::ParseOBJ(objPath, vertices, mesh.indices, true, m_pJobSystem))
+		{
+			return false;
+		}
+
+		if (optimizeVertexOrder)
+		{
+			VertexCache::OptimizeTriangleOrder(mesh.indices, static_cast<uint32_t>(vertices.size()));
+			VertexCache::OptimizeVertexOrder(vertices, mesh.indices);
+		}
+
+		mesh.vertices = VertexStreams{ vertices };
+		mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+		mesh.CalculateBounds();
+
+		//failing to write the cache only costs the next run a parse
+		MeshCache::Save(cachePath, objPath, cacheFlags, mesh);
+	}
+
+	return true;
+}
+
+void Renderer::SetCamera(const Vector3& origin, float pitch, float yaw)
+{
+	m_Camera.origin = origin;
+	m_Camera.totalPitch = pitch;
+	m_Camera.totalYaw = yaw;
+	m_Camera.forward = Matrix::CreateRotation(pitch, yaw, 0).TransformVector(Vector3::UnitZ);
+
+	m_Camera.CalculateViewMatrix();
+	m_Camera.CalculateProjectionMatrix();
+}
+
+void Renderer::SetMeshRotation(float angle)
+{
+	m_pScene->GetInstance(m_VehicleInstanceIdx).worldMatrix = Matrix::CreateRotationY(angle * TO_RADIANS) * Matrix::CreateTranslation(m_MeshPosition);
 }
 
 Renderer::~Renderer()
 {
+	SDL_FreeSurface(m_pBackBuffer);
 	delete[] m_pDepthBufferPixels;
-	delete m_pDiffuseTexture;
-	delete m_pSpecularTexture;
-	delete m_pGlossinessTexture;
-	delete m_pNormalTexture;
-	delete m_pMesh;
+	delete m_pScene;
+	delete m_pJobSystem;
 }
 
 void Renderer::Update(Timer* pTimer)
@@ -87,9 +182,33 @@ void Renderer::Update(Timer* pTimer)
 	m_Camera.Update(pTimer);
 
 	constexpr const float rotationSpeed{ 30.f };
-	if (m_EnableRotating) { m_pMesh->RotateY(rotationSpeed * pTimer->GetElapsed()); }
+	if (m_EnableRotating) { m_pScene->GetInstance(m_VehicleInstanceIdx).RotateY(rotationSpeed * pTimer->GetElapsed()); }
 
 	const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
+	if (pKeyboardState[SDL_SCANCODE_F3])
+	{
+		if (!m_F3Held)
+		{
+			m_TextureFilter = static_cast<TextureFilter>((static_cast<int>(m_TextureFilter) + 1) % (static_cast<int>(TextureFilter::END)));
+
+			std::cout << "[TEXTURE FILTER] ";
+			switch (m_TextureFilter)
+			{
+			case TextureFilter::Point:
+				std::cout << "Point\n";
+				break;
+			case TextureFilter::Bilinear:
+				std::cout << "Bilinear\n";
+				break;
+			case TextureFilter::Trilinear:
+				std::cout << "Trilinear\n";
+				break;
+			}
+		}
+		m_F3Held = true;
+	}
+	else m_F3Held = false;
+
 	if (pKeyboardState[SDL_SCANCODE_F4])
 	{
 		if (!m_F4Held)
@@ -169,37 +288,92 @@ void Renderer::Update(Timer* pTimer)
 	}
 	else m_F6Held = false;
 
+	if (pKeyboardState[SDL_SCANCODE_F8])
+	{
+		if (!m_F8Held)
+		{
+			m_EnableHierarchicalRasterization = !m_EnableHierarchicalRasterization;
+			std::cout << "[HIERARCHICAL RASTERIZATION] ";
+			std::cout << (m_EnableHierarchicalRasterization ? "Hierarchical rasterization enabled\n" : "Hierarchical rasterization disabled\n");
+		}
+		m_F8Held = true;
+	}
+	else m_F8Held = false;
+
+	if (pKeyboardState[SDL_SCANCODE_F9])
+	{
+		if (!m_F9Held)
+		{
+			m_PipelineMode = static_cast<PipelineMode>((static_cast<int>(m_PipelineMode) + 1) % (static_cast<int>(PipelineMode::END)));
+
+			std::cout << "[PIPELINE MODE] ";
+			switch (m_PipelineMode)
+			{
+			case PipelineMode::Forward:
+				std::cout << "Forward\n";
+				break;
+			case PipelineMode::Deferred:
+				std::cout << "Deferred\n";
+				break;
+			case PipelineMode::DepthPrepass:
+				std::cout << "Depth Pre-pass\n";
+				break;
+			}
+		}
+		m_F9Held = true;
+	}
+	else m_F9Held = false;
+
+	if (pKeyboardState[SDL_SCANCODE_F10])
+	{
+		if (!m_F10Held)
+		{
+			Profiler::SetEnabled(!Profiler::IsEnabled());
+			std::cout << "[PROFILER] " << (Profiler::IsEnabled() ? "ON\n" : "OFF\n");
+		}
+		m_F10Held = true;
+	}
+	else m_F10Held = false;
+
 }
 
 void Renderer::Render()
 {
 	//@START
+	Profiler::BeginFrame();
+
 	//Lock BackBuffer
 	SDL_LockSurface(m_pBackBuffer);
 
-	std::fill_n(m_pDepthBufferPixels, (m_Width * m_Height), FLT_MAX); //reset depth buffer
-	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 0, 0, 0)); //clear background
-	
+	{
+		ProfileScope profileScope{ ProfileZone::Clear };
+		ClearDepthBuffer(); //reset depth buffer
+		SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, 0, 0, 0)); //clear background
+	}
 
 	//RENDER LOGIC
-	std::vector<Mesh> meshes_world;
-	meshes_world.push_back(*m_pMesh);
-	RenderMeshes(meshes_world);
+	RenderScene(*m_pScene);
 
 	//@END
 	//Update SDL Surface
 	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (m_pWindow)
+	{
+		ProfileScope profileScope{ ProfileZone::Blit };
+		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
+
+	Profiler::EndFrame();
 }
 
-void Renderer::VertexTransformationFunction(Mesh& mesh)
+void Renderer::VertexTransformationFunction(const Mesh& mesh, const Matrix& worldMatrix, TransformedVertexStreams& vertices_out)
 {
 	//WorldViewProjectionMatrix = WorldMatrix ∗ ViewMatrix ∗ ProjectionMatrix
-	Matrix worldViewProjectionMatrix{ mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+	Matrix worldViewProjectionMatrix{ worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
 		
-	mesh.vertices_out.clear();
-	mesh.vertices_out.reserve(mesh.vertices.size());
+	//sized up front so every chunk can write its own range without synchronizing
+	vertices_out.resize(mesh.vertices.size());
 
 		/*Week 1 & 2*/
 		//for (auto& vertex : mesh.vertices)
@@ -227,28 +401,47 @@ void Renderer::VertexTransformationFunction(Mesh& mesh)
 		//	mesh.vertices_out.emplace_back(screenSpaceVertex);
 		//}
 
-		for (auto& vertex : mesh.vertices)
-		{
-			Vertex_Out vertex_out{ Vector4{}, vertex.color, vertex.uv, vertex.normal, vertex.tangent };
+		const VertexStreams& vertices{ mesh.vertices };
+
+		// One loop per stream, each only walks the arrays it reads and writes
+		m_pJobSystem->ParallelFor(static_cast<uint32_t>(vertices.size()), m_VertexChunkSize, [&](uint32_t firstVertex, uint32_t lastVertex)
+			{
+				{
+					ProfileScope profileScope{ ProfileZone::VertexTransform };
+					for (uint32_t vertexIdx{ firstVertex }; vertexIdx < lastVertex; ++vertexIdx)
+					{
+						Vector4 position{ worldViewProjectionMatrix.TransformPoint({ vertices.positions[vertexIdx], 1.0f }) };
+						vertices_out.viewDirections[vertexIdx] = Vector3{ position.x, position.y, position.z }.Normalized();
+						vertices_out.clipCodes[vertexIdx] = Clipping::GetClipCode(ToClipSpace(position));
 
-			vertex_out.position = worldViewProjectionMatrix.TransformPoint({ vertex.position, 1.0f });
-			vertex_out.viewDirection = Vector3{ vertex_out.position.x, vertex_out.position.y, vertex_out.position.z }.Normalized();
+						//perspective divide to put vertices in NDC
+						const float invertedViewSpaceW{ 1 / position.w };
+						position.x *= invertedViewSpaceW;
+						position.y *= invertedViewSpaceW;
+						position.z *= invertedViewSpaceW;
 
-			vertex_out.normal = mesh.worldMatrix.TransformVector(vertex.normal);
-			vertex_out.tangent = mesh.worldMatrix.TransformVector(vertex.tangent);
+						position.x = position.x / m_AspectRatio;// / (m_Camera.fov * m_AspectRatio);
 
-			//perspective divide to put vertices in NDC
-			const float invertedViewSpaceW{ 1 / vertex_out.position.w };
-			vertex_out.position.x *= invertedViewSpaceW;
-			vertex_out.position.y *= invertedViewSpaceW;
-			vertex_out.position.z *= invertedViewSpaceW;
+						vertices_out.positions[vertexIdx] = position;
+					}
 
-			vertex_out.position.x = vertex_out.position.x / m_AspectRatio;// / (m_Camera.fov * m_AspectRatio);
-			vertex_out.position.y = vertex_out.position.y  ;// / m_Camera.fov;
+					for (uint32_t vertexIdx{ firstVertex }; vertexIdx < lastVertex; ++vertexIdx)
+					{
+						vertices_out.normals[vertexIdx] = worldMatrix.TransformVector(vertices.normals[vertexIdx]);
+					}
 
-			//emplace back because we made vOut just to store in this vector
-			mesh.vertices_out.emplace_back(vertex_out);
-		}
+					for (uint32_t vertexIdx{ firstVertex }; vertexIdx < lastVertex; ++vertexIdx)
+					{
+						vertices_out.tangents[vertexIdx] = worldMatrix.TransformVector(vertices.tangents[vertexIdx]);
+					}
+				}
+
+				ProfileScope profileScope{ ProfileZone::NDCtoScreenSpace };
+				for (uint32_t vertexIdx{ firstVertex }; vertexIdx < lastVertex; ++vertexIdx)
+				{
+					NDCtoScreenSpace(vertices_out.positions[vertexIdx]);
+				}
+			});
 }
 
 bool Renderer::SaveBufferToImage() const
@@ -256,188 +449,705 @@ bool Renderer::SaveBufferToImage() const
 	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
 }
 
-void Renderer::RenderTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2) const
+uint32_t Renderer::GetColorBufferPitch() const
 {
-	// If a triangle has the same vertex twice, it means it has no surface and can't be rendered.
-	if (v0 == v1 || v1 == v2 || v2 == v0)
-	{
-		return;
-	}
-
-	std::vector<Vertex_Out> triangle
-	{
-		v0,
-		v1,
-		v2,
-	};
-
-	const Vector2 V0{ v0.position.x, v0.position.y };
-	const Vector2 V1{ v1.position.x, v1.position.y };
-	const Vector2 V2{ v2.position.x, v2.position.y };
+	//in pixels, SDL can pad the rows of a surface
+	return static_cast<uint32_t>(m_pBackBuffer->pitch) / sizeof(uint32_t);
+}
 
-	//bounding box
-	int minX = std::min({ v0.position.x, v1.position.x, v2.position.x });
-	int maxX = std::max({ v0.position.x, v1.position.x, v2.position.x });;
-	int minY = std::min({ v0.position.y, v1.position.y, v2.position.y });;
-	int maxY = std::max({ v0.position.y, v1.position.y, v2.position.y });;
+static void CalculateBoundingBox(const Vector4& p0, const Vector4& p1, const Vector4& p2, int width, int height, int& minX, int& minY, int& maxX, int& maxY)
+{
+	minX = static_cast<int>(std::min({ p0.x, p1.x, p2.x }));
+	maxX = static_cast<int>(std::max({ p0.x, p1.x, p2.x }));
+	minY = static_cast<int>(std::min({ p0.y, p1.y, p2.y }));
+	maxY = static_cast<int>(std::max({ p0.y, p1.y, p2.y }));
 
 	// Add margin to prevent seethrough lines between quads
-	const float margin{ 1.f };
+	const int margin{ 1 };
 	minX -= margin;
 	minY -= margin;
 	maxX += margin;
 	maxY += margin;
 
 	// Make sure the boundingbox is on the screen
-	minX = Clamp(minX, 0, m_Width);
-	minY = Clamp(minY, 0, m_Height);
-	maxX = Clamp(maxX, 0, m_Width);
-	maxY = Clamp(maxY, 0, m_Height);
+	minX = Clamp(minX, 0, width);
+	minY = Clamp(minY, 0, height);
+	maxX = Clamp(maxX, 0, width);
+	maxY = Clamp(maxY, 0, height);
+}
 
-	float area = Vector2::Cross(V1 - V0, V2 - V0);
+// 1 / (w0 / z0 + w1 / z1 + w2 / z2) can round a few ulps past the nearest or farthest vertex,
+// so the range is widened a bit to keep the Hi-Z tests conservative (the equal test of the pre-pass needs every visible fragment)
+static void CalculateDepthRange(const Vector4& p0, const Vector4& p1, const Vector4& p2, float& minDepth, float& maxDepth)
+{
+	const float tolerance{ 8 * FLT_EPSILON };
+	minDepth = std::min({ p0.z, p1.z, p2.z }) * (1.f - tolerance);
+	maxDepth = std::max({ p0.z, p1.z, p2.z }) * (1.f + tolerance);
+}
 
-	for (int px{ minX }; px < maxX; ++px)
+bool Renderer::RenderTriangle(const BinnedTriangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, RasterPass pass, uint32_t triangleIdx, ShadingTimeSample* pShadingSample) const
+{
+	//only the positions are read here, the other attributes are left alone until a fragment gets shaded
+	const std::vector<Vector4>& positions{ triangle.pVertices_out->positions };
+	const Vector4& p0{ positions[triangle.vertexIdx[0]] };
+	const Vector4& p1{ positions[triangle.vertexIdx[1]] };
+	const Vector4& p2{ positions[triangle.vertexIdx[2]] };
+
+	const Vector2 V0{ p0.x, p0.y };
+	const Vector2 V1{ p1.x, p1.y };
+	const Vector2 V2{ p2.x, p2.y };
+
+	//bounding box, limited to the tile that is being rasterized
+	int minX, minY, maxX, maxY;
+	CalculateBoundingBox(p0, p1, p2, m_Width, m_Height, minX, minY, maxX, maxY);
+
+	minX = std::max(minX, tileMinX);
+	minY = std::max(minY, tileMinY);
+	maxX = std::min(maxX, tileMaxX);
+	maxY = std::min(maxY, tileMaxY);
+
+	// Edge functions give coverage and barycentric weights in one go, a whole row block at a time
+	const TriangleEdges edges{ V0, V1, V2 };
+
+	const float depth0{ p0.z };
+	const float depth1{ p1.z };
+	const float depth2{ p2.z };
+
+	const float invDepth0{ 1.0f / depth0 };
+	const float invDepth1{ 1.0f / depth1 };
+	const float invDepth2{ 1.0f / depth2 };
+
+	// Interpolated depth always lies between the nearest and farthest vertex
+	float triangleMinDepth{};
+	float triangleMaxDepth{};
+	CalculateDepthRange(p0, p1, p2, triangleMinDepth, triangleMaxDepth);
+
+	bool hasWrittenDepth{ false };
+
+	//kept local, the profiler is only told once per triangle
+	uint64_t numTested{};
+	uint64_t numPassed{};
+	uint64_t numShaded{};
+
+	float weights0[EdgeFunctions::BlockWidth];
+	float weights1[EdgeFunctions::BlockWidth];
+	float weights2[EdgeFunctions::BlockWidth];
+
+	// Walk the bounding box in blocks on a fixed 8x8 grid, each block row by row so the depth and color buffer are walked in memory order.
+	// In hierarchical mode every block is tested against the edges first: blocks outside the triangle are skipped,
+	// blocks completely inside skip the coverage test (the weights are still needed for interpolation).
+	const int firstBlockX{ minX - minX % EdgeFunctions::BlockWidth };
+	const int firstBlockY{ minY - minY % EdgeFunctions::BlockHeight };
+
+	for (int blockY{ firstBlockY }; blockY < maxY; blockY += EdgeFunctions::BlockHeight)
 	{
-		for (int py{ minY }; py < maxY; ++py)
+		const int blockMinY{ std::max(blockY, minY) };
+		const int blockMaxY{ std::min(blockY + EdgeFunctions::BlockHeight, maxY) };
+
+		for (int blockX{ firstBlockX }; blockX < maxX; blockX += EdgeFunctions::BlockWidth)
 		{
-			Vector2 pixel{ float(px) + 0.5f, float(py) + 0.5f }; // checking pixel from the center
-			Vector3 point{ float(px) + 0.5f, float(py) + 0.5f , 0 };
-			const int pixelIdx{ px + py * m_Width };
+			const int blockMinX{ std::max(blockX, minX) };
+			const int blockMaxX{ std::min(blockX + EdgeFunctions::BlockWidth, maxX) };
+
+			// Hi-Z: the whole triangle is behind everything already in this block
+			const int depthBlockIdx{ blockX / EdgeFunctions::BlockWidth + (blockY / EdgeFunctions::BlockHeight) * m_NumDepthBlocksX };
+			if (triangleMinDepth > m_BlockMaxDepth[depthBlockIdx]) continue;
 
-			//const bool isInTriangle = weight0 > 0 && weight1 > 0 && weight2 > 0;
-			if (Utils::IsPointInTriangle(point, triangle))
+			// ...or in front of it, then the depth buffer doesn't have to be read (the equal test always needs it)
+			const bool isInFrontOfBlock{ pass != RasterPass::ShadeEqualDepth && triangleMaxDepth < m_BlockMinDepth[depthBlockIdx] };
+			bool hasWrittenBlock{ false };
+
+			BlockCoverage blockCoverage{ BlockCoverage::Partial };
+			if (m_EnableHierarchicalRasterization)
 			{
-				float weight0 = Vector2::Cross(V2 - V1, pixel - V1) / area;
-				float weight1 = Vector2::Cross(V0 - V2, pixel - V2) / area;
-				float weight2 = Vector2::Cross(V1 - V0, pixel - V0) / area;
+				blockCoverage = EdgeFunctions::ClassifyBlock(edges, blockMinX, blockMinY, blockMaxX, blockMaxY);
+				if (blockCoverage == BlockCoverage::Outside) continue;
+			}
+
+			//the block can stick out of the bounding box on both sides
+			const uint32_t blockMask{ ((1u << (blockMaxX - blockX)) - 1) & ~((1u << (blockMinX - blockX)) - 1) };
+
+			for (int py{ blockMinY }; py < blockMaxY; ++py)
+			{
+				uint32_t coverage{ EdgeFunctions::EvaluateRow(edges, blockX, py, weights0, weights1, weights2) };
+				coverage = (blockCoverage == BlockCoverage::Inside ? blockMask : coverage & blockMask);
+
+				while (coverage)
+				{
+					const int lane{ std::countr_zero(coverage) };
+					coverage &= coverage - 1;
+
+					const int px{ blockX + lane };
+					const int pixelIdx{ px + py * m_Width };
+
+					const float weight0{ weights0[lane] };
+					const float weight1{ weights1[lane] };
+					const float weight2{ weights2[lane] };
+
+					const float interpolatedDepth{ 1.f / (invDepth0 * weight0 + invDepth1 * weight1 + invDepth2 * weight2) }; //interpolated Z
+					++numTested;
+
+					//clipping keeps the depth in [0, 1], this only catches rounding right at the near and far plane
+					if (interpolatedDepth < 0.f || interpolatedDepth > 1.f) continue;
+
+					//depth was written by the pre-pass with the exact same math, so only the visible fragment matches
+					if (pass == RasterPass::ShadeEqualDepth)
+					{
+						if (m_pDepthBufferPixels[pixelIdx] != interpolatedDepth) continue;
+						PixelShading(InterpolatePixel(triangle, px, py, weight0, weight1, weight2, interpolatedDepth), *triangle.pMaterial);
+						++numPassed;
+						++numShaded;
+						continue;
+					}
+
+					if (!isInFrontOfBlock && m_pDepthBufferPixels[pixelIdx] < interpolatedDepth) continue;
+					m_pDepthBufferPixels[pixelIdx] = interpolatedDepth;
+
+					m_BlockMinDepth[depthBlockIdx] = std::min(m_BlockMinDepth[depthBlockIdx], interpolatedDepth);
+					hasWrittenBlock = true;
+					++numPassed;
+
+					switch (pass)
+					{
+					case RasterPass::Forward:
+						if (pShadingSample && pShadingSample->numFragments++ % ShadingTimeSample::SampleRate == 0)
+						{
+							const std::chrono::steady_clock::time_point shadingStart{ std::chrono::steady_clock::now() };
+							PixelShading(InterpolatePixel(triangle, px, py, weight0, weight1, weight2, interpolatedDepth), *triangle.pMaterial);
+							pShadingSample->sampledTime += std::chrono::steady_clock::now() - shadingStart;
+						}
+						else
+						{
+							PixelShading(InterpolatePixel(triangle, px, py, weight0, weight1, weight2, interpolatedDepth), *triangle.pMaterial);
+						}
+						++numShaded;
+						break;
+					case RasterPass::Visibility:
+						//only remember what is visible, ShadeVisibilityBuffer does the rest
+						m_VisibilityBuffer[pixelIdx] = VisibilitySample{ triangleIdx, weight0, weight1, weight2 };
+						break;
+					default:
+						break;
+					}
+				}
+			}
+
+			//depth only gets closer, so the farthest depth of the block can only have moved in
+			if (hasWrittenBlock)
+			{
+				UpdateBlockMaxDepth(blockX / EdgeFunctions::BlockWidth, blockY / EdgeFunctions::BlockHeight);
+				hasWrittenDepth = true;
+			}
+		}
+	}
+
+	Profiler::AddCount(ProfileCounter::FragmentsTested, numTested);
+	Profiler::AddCount(ProfileCounter::FragmentsPassed, numPassed);
+	Profiler::AddCount(ProfileCounter::FragmentsShaded, numShaded);
+
+	return hasWrittenDepth;
+}
+
+Vertex_Out Renderer::InterpolatePixel(const BinnedTriangle& triangle, int px, int py, float weight0, float weight1, float weight2, float interpolatedDepth) const
+{
+	const VertexStreams& vertices{ *triangle.pVertices };
+	const TransformedVertexStreams& vertices_out{ *triangle.pVertices_out };
+	const uint32_t idx0{ triangle.vertexIdx[0] };
+	const uint32_t idx1{ triangle.vertexIdx[1] };
+	const uint32_t idx2{ triangle.vertexIdx[2] };
+
+	const Vector4& p0{ vertices_out.positions[idx0] };
+	const Vector4& p1{ vertices_out.positions[idx1] };
+	const Vector4& p2{ vertices_out.positions[idx2] };
+
+	const float depth0{ p0.z };
+	const float depth1{ p1.z };
+	const float depth2{ p2.z };
+
+	const Vector2 pixel{ float(px) + 0.5f, float(py) + 0.5f }; // checking pixel from the center
+
+	const Vector2 uvOverDepth0{ vertices.uvs[idx0] / depth0 };
+	const Vector2 uvOverDepth1{ vertices.uvs[idx1] / depth1 };
+	const Vector2 uvOverDepth2{ vertices.uvs[idx2] / depth2 };
+
+	Vertex_Out pixelOut{};
+	pixelOut.position = { pixel.x,pixel.y, interpolatedDepth,interpolatedDepth };
+	pixelOut.uv = (uvOverDepth0 * weight0 + uvOverDepth1 * weight1 + uvOverDepth2 * weight2) * interpolatedDepth;
+
+	if (m_TextureFilter != TextureFilter::Point)
+	{
+		// The weights are linear in screen space, so those of the pixel to the right and the one below are a constant step away.
+		// Interpolating the uv there the same way gives the difference a 2x2 pixel quad would give, without shading the neighbours
+		const float area{ (p1.y - p2.y) * (p0.x - p2.x) + (p2.x - p1.x) * (p0.y - p2.y) };
+		const float weight0Ddx{ (p1.y - p2.y) / area };
+		const float weight1Ddx{ (p2.y - p0.y) / area };
+		const float weight2Ddx{ -weight0Ddx - weight1Ddx };
+		const float weight0Ddy{ (p2.x - p1.x) / area };
+		const float weight1Ddy{ (p0.x - p2.x) / area };
+		const float weight2Ddy{ -weight0Ddy - weight1Ddy };
+
+		const float invDepth{ 1.f / interpolatedDepth };
+		const auto InterpolateUVAt = [&](float weight0Step, float weight1Step, float weight2Step)
+			{
+				const Vector2 uvOverDepth{ uvOverDepth0 * (weight0 + weight0Step) + uvOverDepth1 * (weight1 + weight1Step) + uvOverDepth2 * (weight2 + weight2Step) };
+				return uvOverDepth / (invDepth + weight0Step / depth0 + weight1Step / depth1 + weight2Step / depth2);
+			};
+		pixelOut.uvDdx = InterpolateUVAt(weight0Ddx, weight1Ddx, weight2Ddx) - pixelOut.uv;
+		pixelOut.uvDdy = InterpolateUVAt(weight0Ddy, weight1Ddy, weight2Ddy) - pixelOut.uv;
+	}
+	pixelOut.normal = Vector3{ interpolatedDepth * (weight0 * vertices_out.normals[idx0] / p0.w + weight1 * vertices_out.normals[idx1] / p1.w + weight2 * vertices_out.normals[idx2] / p2.w) }.Normalized();
+	pixelOut.tangent = Vector3{ interpolatedDepth * (weight0 * vertices_out.tangents[idx0] / p0.w + weight1 * vertices_out.tangents[idx1] / p1.w + weight2 * vertices_out.tangents[idx2] / p2.w) }.Normalized();
+	pixelOut.viewDirection = Vector3{ interpolatedDepth * (weight0 * vertices_out.viewDirections[idx0] / p0.w + weight1 * vertices_out.viewDirections[idx1] / p1.w + weight2 * vertices_out.viewDirections[idx2] / p2.w) }.Normalized();
+
+	return pixelOut;
+}
+
+void Renderer::ShadeVisibilityBuffer() const
+{
+	// Second pass of deferred shading: every covered pixel rebuilds its attributes from the triangle that won the depth test, and is shaded exactly once
+	m_pJobSystem->ParallelFor(static_cast<uint32_t>(m_Height), 8, [this](uint32_t firstRow, uint32_t lastRow)
+		{
+			ProfileScope profileScope{ ProfileZone::PixelShading };
+			uint64_t numShaded{};
+
+			for (int py{ static_cast<int>(firstRow) }; py < static_cast<int>(lastRow); ++py)
+			{
+				for (int px{}; px < m_Width; ++px)
+				{
+					VisibilitySample& sample{ m_VisibilityBuffer[px + py * m_Width] };
+					if (sample.triangleIdx == UINT32_MAX) continue;
+
+					const BinnedTriangle& triangle{ m_BinnedTriangles[sample.triangleIdx] };
+					const std::vector<Vector4>& positions{ triangle.pVertices_out->positions };
+					const float depth0{ positions[triangle.vertexIdx[0]].z };
+					const float depth1{ positions[triangle.vertexIdx[1]].z };
+					const float depth2{ positions[triangle.vertexIdx[2]].z };
+
+					//same formula as the raster loop, so the depth matches the one that won the test
+					const float interpolatedDepth{ 1.f / ((1.0f / depth0) * sample.weight0 + (1.0f / depth1) * sample.weight1 + (1.0f / depth2) * sample.weight2) };
+					PixelShading(InterpolatePixel(triangle, px, py, sample.weight0, sample.weight1, sample.weight2, interpolatedDepth), *triangle.pMaterial);
+					++numShaded;
+
+					//leave the buffer empty for the next frame
+					sample.triangleIdx = UINT32_MAX;
+				}
+			}
+
+			Profiler::AddCount(ProfileCounter::FragmentsShaded, numShaded);
+		});
+}
+
+bool Renderer::BinTriangle(const BinnedTriangle& triangle, CullMode cullMode)
+{
+	const std::vector<Vector4>& positions{ triangle.pVertices_out->positions };
+	const Vector4& p0{ positions[triangle.vertexIdx[0]] };
+	const Vector4& p1{ positions[triangle.vertexIdx[1]] };
+	const Vector4& p2{ positions[triangle.vertexIdx[2]] };
+
+	// Signed area like in TriangleEdges, positive when the triangle is clockwise on screen (y points down)
+	const Vector2 V0{ p0.x, p0.y };
+	const float area{ Vector2::Cross(Vector2{ p1.x, p1.y } - V0, Vector2{ p2.x, p2.y } - V0) };
+
+	// Degenerate triangles never cover a pixel (and the edge functions divide by the area), don't bother storing them
+	if (!(area != 0.f))
+	{
+		return false;
+	}
+
+	if ((cullMode == CullMode::Back && area < 0.f) || (cullMode == CullMode::Front && area > 0.f))
+	{
+		return false;
+	}
+
+	int minX, minY, maxX, maxY;
+	CalculateBoundingBox(p0, p1, p2, m_Width, m_Height, minX, minY, maxX, maxY);
+	if (minX >= maxX || minY >= maxY)
+	{
+		return false;
+	}
+
+	const uint32_t triangleIdx{ static_cast<uint32_t>(m_BinnedTriangles.size()) };
+	m_BinnedTriangles.push_back(triangle);
+
+	// maxX/maxY are exclusive
+	const int minTileX{ minX / m_TileSize };
+	const int minTileY{ minY / m_TileSize };
+	const int maxTileX{ (maxX - 1) / m_TileSize };
+	const int maxTileY{ (maxY - 1) / m_TileSize };
 
-				const float depth0{ v0.position.z };
-				const float depth1{ v1.position.z };
-				const float depth2{ v2.position.z };
+	for (int tileY{ minTileY }; tileY <= maxTileY; ++tileY)
+	{
+		for (int tileX{ minTileX }; tileX <= maxTileX; ++tileX)
+		{
+			m_TileBins[tileX + tileY * m_NumTilesX].push_back(triangleIdx);
+		}
+	}
+	return true;
+}
 
-				//const float interpolatedZ{ 1.f / ((weight0 * (1.f / v0.position.z) + (weight1 * (1.f / v1.position.z)) + (weight2 * (1.f / v2.position.z)))) };
-				const float interpolatedDepth = CalculateInterpolatedZ(triangle, weight0, weight1, weight2); //interpolated Z
+void Renderer::RenderTiles(RasterPass pass) const
+{
+	using Clock = std::chrono::steady_clock;
 
+	// Every tile is finished before the next one starts, so its part of the color and depth buffer stays in cache.
+	// Triangles keep their submission order inside a bin, which keeps the depth test result identical to drawing them one by one.
+	// Tiles don't share any pixels, so they are handed to the job system and the image doesn't depend on the thread count.
+	m_pJobSystem->ParallelFor(static_cast<uint32_t>(m_TileBins.size()), 1, [this, pass](uint32_t firstTile, uint32_t lastTile)
+		{
+			for (uint32_t tileIdx{ firstTile }; tileIdx < lastTile; ++tileIdx)
+			{
+				const int tileX{ static_cast<int>(tileIdx) % m_NumTilesX };
+				const int tileY{ static_cast<int>(tileIdx) / m_NumTilesX };
+
+				const int tileMinX{ tileX * m_TileSize };
+				const int tileMinY{ tileY * m_TileSize };
+				const int tileMaxX{ std::min(tileMinX + m_TileSize, m_Width) };
+				const int tileMaxY{ std::min(tileMinY + m_TileSize, m_Height) };
+
+				//the equal depth pass does nothing but shading, the depth only and visibility passes nothing but rasterization.
+				//Forward does both in one loop, there the sampled shading time is split off the end of the tile
+				const bool isProfiling{ Profiler::IsEnabled() };
+				const Clock::time_point tileStart{ isProfiling ? Clock::now() : Clock::time_point{} };
+				ShadingTimeSample shadingSample{};
+				ShadingTimeSample* pShadingSample{ isProfiling && pass == RasterPass::Forward ? &shadingSample : nullptr };
+
+				for (const uint32_t triangleIdx : m_TileBins[tileIdx])
+				{
+					const BinnedTriangle& triangle{ m_BinnedTriangles[triangleIdx] };
+					const std::vector<Vector4>& positions{ triangle.pVertices_out->positions };
 
-				//makes sure that the object is not rendered if it is behind camera(otherwise mirrored)  (Frustum clipping)
-				float depth = m_pDepthBufferPixels[pixelIdx];
-				if (depth < interpolatedDepth || interpolatedDepth < 0.f || interpolatedDepth > 1.f) continue;
-				m_pDepthBufferPixels[pixelIdx] = interpolatedDepth;
+					// Hi-Z: skip the whole triangle when it is behind everything in the tile, before any setup
+					float triangleMinDepth{};
+					float triangleMaxDepth{};
+					CalculateDepthRange(positions[triangle.vertexIdx[0]], positions[triangle.vertexIdx[1]], positions[triangle.vertexIdx[2]], triangleMinDepth, triangleMaxDepth);
+					if (triangleMinDepth > m_TileMaxDepth[tileIdx]) continue;
 
-				
-				Vertex_Out pixelOut{};
-				pixelOut.position = { pixel.x,pixel.y, interpolatedDepth,interpolatedDepth };
-				pixelOut.uv = ((v0.uv / depth0) * weight0 + (v1.uv / depth1) * weight1 + (v2.uv / depth2) * weight2) * interpolatedDepth;
-				pixelOut.normal = Vector3{ interpolatedDepth * (weight0 * v0.normal / v0.position.w + weight1 * v1.normal / v1.position.w + weight2 * v2.normal / v2.position.w) }.Normalized();
-				pixelOut.tangent = Vector3{ interpolatedDepth * (weight0 * v0.tangent / v0.position.w + weight1 * v1.tangent /v1.position.w + weight2 * v2.tangent / v2.position.w) }.Normalized();
-				pixelOut.viewDirection = Vector3{ interpolatedDepth * (weight0 * v0.viewDirection / v0.position.w + weight1 * v1.viewDirection / v1.position.w + weight2 * v2.viewDirection /v2.position.w) }.Normalized();
+					if (RenderTriangle(triangle, tileMinX, tileMinY, tileMaxX, tileMaxY, pass, triangleIdx, pShadingSample))
+					{
+						UpdateTileMaxDepth(tileX, tileY);
+					}
+				}
 
-				PixelShading(pixelOut);
+				if (isProfiling)
+				{
+					const Clock::time_point tileEnd{ Clock::now() };
+					const Clock::duration shadingTime{ std::min<Clock::duration>(shadingSample.sampledTime * ShadingTimeSample::SampleRate, tileEnd - tileStart) };
+					if (pass == RasterPass::ShadeEqualDepth)
+					{
+						Profiler::RecordZone(ProfileZone::PixelShading, tileStart, tileEnd);
+					}
+					else
+					{
+						Profiler::RecordZone(ProfileZone::Rasterization, tileStart, tileEnd - shadingTime);
+						if (pShadingSample)
+						{
+							Profiler::RecordZone(ProfileZone::PixelShading, tileEnd - shadingTime, tileEnd);
+						}
+					}
+				}
 			}
+		});
+}
+
+void Renderer::ClearDepthBuffer()
+{
+	std::fill_n(m_pDepthBufferPixels, (m_Width * m_Height), FLT_MAX);
+	std::fill(m_BlockMinDepth.begin(), m_BlockMinDepth.end(), FLT_MAX);
+	std::fill(m_BlockMaxDepth.begin(), m_BlockMaxDepth.end(), FLT_MAX);
+	std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), FLT_MAX);
+}
+
+void Renderer::UpdateBlockMaxDepth(int blockX, int blockY) const
+{
+	const int minX{ blockX * EdgeFunctions::BlockWidth };
+	const int minY{ blockY * EdgeFunctions::BlockHeight };
+	const int maxX{ std::min(minX + EdgeFunctions::BlockWidth, m_Width) };
+	const int maxY{ std::min(minY + EdgeFunctions::BlockHeight, m_Height) };
+
+	float maxDepth{ 0.f };
+	for (int py{ minY }; py < maxY; ++py)
+	{
+		const float* pRow{ m_pDepthBufferPixels + py * m_Width };
+		for (int px{ minX }; px < maxX; ++px)
+		{
+			maxDepth = std::max(maxDepth, pRow[px]);
 		}
 	}
+	m_BlockMaxDepth[blockX + blockY * m_NumDepthBlocksX] = maxDepth;
+}
+
+void Renderer::UpdateTileMaxDepth(int tileX, int tileY) const
+{
+	constexpr int blocksPerTileX{ m_TileSize / EdgeFunctions::BlockWidth };
+	constexpr int blocksPerTileY{ m_TileSize / EdgeFunctions::BlockHeight };
 
+	const int minBlockX{ tileX * blocksPerTileX };
+	const int minBlockY{ tileY * blocksPerTileY };
+	const int maxBlockX{ std::min(minBlockX + blocksPerTileX, m_NumDepthBlocksX) };
+	const int maxBlockY{ std::min(minBlockY + blocksPerTileY, m_NumDepthBlocksY) };
+
+	float maxDepth{ 0.f };
+	for (int blockY{ minBlockY }; blockY < maxBlockY; ++blockY)
+	{
+		for (int blockX{ minBlockX }; blockX < maxBlockX; ++blockX)
+		{
+			maxDepth = std::max(maxDepth, m_BlockMaxDepth[blockX + blockY * m_NumDepthBlocksX]);
+		}
+	}
+	m_TileMaxDepth[tileX + tileY * m_NumTilesX] = maxDepth;
 }
 
-void Renderer::NDCtoScreenSpace(Vertex_Out& v0, Vertex_Out& v1, Vertex_Out& v2)
+void Renderer::NDCtoScreenSpace(Vector4& position) const
 {
 	//NDC --> Screenspace
-	v0.position.x = ((v0.position.x + 1.f) / 2.f) * m_Width;
-	v0.position.y = ((1.f - v0.position.y) / 2.f) * m_Height;
-	v1.position.x = ((v1.position.x + 1.f) / 2.f) * m_Width;
-	v1.position.y = ((1.f - v1.position.y) / 2.f) * m_Height;
-	v2.position.x = ((v2.position.x + 1.f) / 2.f) * m_Width;
-	v2.position.y = ((1.f - v2.position.y) / 2.f) * m_Height;
+	position.x = ((position.x + 1.f) / 2.f) * m_Width;
+	position.y = ((1.f - position.y) / 2.f) * m_Height;
 }
 
-void Renderer::RenderMeshes(std::vector<Mesh> meshes_world)
+Vector4 Renderer::ToClipSpace(const Vector4& position) const
 {
-	for (auto& mesh : meshes_world)
+	//the vertex stage divides x by the aspect ratio on top of the projection matrix, the clip planes have to see the same x
+	return Vector4{ position.x / m_AspectRatio, position.y, position.z, position.w };
+}
+
+uint32_t Renderer::AddClippedVertex(const TransformedVertexStreams& vertices_out, const ClipVertex& vertex)
+{
+	Vector4 position{};
+	if (vertex.vertexIdx != UINT32_MAX)
+	{
+		//exactly where the unclipped neighbours of the triangle have it, so no cracks open up along shared edges
+		position = vertices_out.positions[vertex.vertexIdx];
+	}
+	else
+	{
+		const float invertedW{ 1 / vertex.position.w };
+		position = Vector4{ vertex.position.x * invertedW, vertex.position.y * invertedW, vertex.position.z * invertedW, vertex.position.w };
+		NDCtoScreenSpace(position);
+	}
+
+	const uint32_t vertexIdx{ static_cast<uint32_t>(m_ClippedVertices_out.size()) };
+
+	m_ClippedVertices.push_back(Vertex{ {}, colors::White, vertex.uv });
+	m_ClippedVertices_out.positions.push_back(position);
+	m_ClippedVertices_out.normals.push_back(vertex.normal);
+	m_ClippedVertices_out.tangents.push_back(vertex.tangent);
+	m_ClippedVertices_out.viewDirections.push_back(vertex.viewDirection);
+	m_ClippedVertices_out.clipCodes.push_back(0);
+	return vertexIdx;
+}
+
+void Renderer::ClipTriangle(const BinnedTriangle& triangle, const Matrix& worldViewProjectionMatrix, uint8_t clipCodes, CullMode cullMode)
+{
+	// The vertex stage only kept the positions after the divide, the clip space ones of these three are transformed again
+	const VertexStreams& vertices{ *triangle.pVertices };
+	const TransformedVertexStreams& vertices_out{ *triangle.pVertices_out };
+
+	ClipVertex polygon[Clipping::MaxPolygonSize]{};
+	for (int corner{}; corner < 3; ++corner)
+	{
+		const uint32_t vertexIdx{ triangle.vertexIdx[corner] };
+		const Vector4 position{ worldViewProjectionMatrix.TransformPoint({ vertices.positions[vertexIdx], 1.0f }) };
+		polygon[corner] = ClipVertex{ ToClipSpace(position), vertices.uvs[vertexIdx], vertices_out.normals[vertexIdx], vertices_out.tangents[vertexIdx], vertices_out.viewDirections[vertexIdx], vertexIdx };
+	}
+
+	const int vertexCount{ Clipping::ClipPolygon(polygon, 3, clipCodes) };
+	if (vertexCount < 3)
+	{
+		return;
+	}
+
+	uint32_t clippedIndices[Clipping::MaxPolygonSize]{};
+	for (int vertexIdx{}; vertexIdx < vertexCount; ++vertexIdx)
 	{
-		VertexTransformationFunction(mesh);
+		clippedIndices[vertexIdx] = AddClippedVertex(vertices_out, polygon[vertexIdx]);
+	}
+
+	//the polygon is convex and keeps the winding of the triangle, so a fan does
+	for (int vertexIdx{ 1 }; vertexIdx + 1 < vertexCount; ++vertexIdx)
+	{
+		BinTriangle(BinnedTriangle{ &m_ClippedVertices, &m_ClippedVertices_out, triangle.pMaterial, { clippedIndices[0], clippedIndices[vertexIdx], clippedIndices[vertexIdx + 1] } }, cullMode);
+	}
+}
+
+void Renderer::RenderScene(const Scene& scene)
+{
+	//clear last frame's bins, keeps their capacity
+	m_BinnedTriangles.clear();
+	for (auto& bin : m_TileBins)
+	{
+		bin.clear();
+	}
+	m_ClippedVertices.clear();
+	m_ClippedVertices_out.resize(0);
+
+	using Clock = std::chrono::steady_clock;
+	const auto ToMilliseconds = [](Clock::duration duration) { return std::chrono::duration<float, std::milli>(duration).count(); };
+	const Clock::time_point geometryStart{ Clock::now() };
+
+	// Instances completely outside the view are skipped before a single vertex is transformed.
+	// The planes get the same extra division of x by the aspect ratio as the vertex stage
+	const std::vector<MeshInstance>& instances{ scene.GetInstances() };
+	m_VisibleInstances.clear();
+	for (uint32_t instanceIdx{}; instanceIdx < instances.size(); ++instanceIdx)
+	{
+		const MeshInstance& instance{ instances[instanceIdx] };
+		const Mesh& mesh{ scene.GetMesh(instance.meshIdx) };
+		const Frustum frustum{ instance.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix * Matrix::CreateScale(1.f / m_AspectRatio, 1.f, 1.f) };
+		if (!frustum.IsOutside(mesh.boundingSphere) && !frustum.IsOutside(mesh.boundingBox))
+		{
+			m_VisibleInstances.push_back(instanceIdx);
+		}
+	}
+	Profiler::AddCount(ProfileCounter::InstancesIn, instances.size());
+	Profiler::AddCount(ProfileCounter::InstancesCulled, instances.size() - m_VisibleInstances.size());
+
+	// Every visible instance transforms its mesh into a buffer of its own. They only grow, so the binned triangles can point into them
+	if (m_TransformedVertices.size() < m_VisibleInstances.size())
+	{
+		m_TransformedVertices.resize(m_VisibleInstances.size());
+	}
+
+	for (size_t visibleIdx{}; visibleIdx < m_VisibleInstances.size(); ++visibleIdx)
+	{
+		const MeshInstance& instance{ instances[m_VisibleInstances[visibleIdx]] };
+		const Mesh& mesh{ scene.GetMesh(instance.meshIdx) };
+		const Material& material{ scene.GetMaterial(instance.materialIdx) };
+		TransformedVertexStreams& vertices_out{ m_TransformedVertices[visibleIdx] };
+		const Matrix worldViewProjectionMatrix{ instance.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix };
+
+		VertexTransformationFunction(mesh, instance.worldMatrix, vertices_out);
+
+		ProfileScope profileScope{ ProfileZone::Clipping };
+		const std::vector<uint8_t>& clipCodes{ vertices_out.clipCodes };
+		uint64_t numTriangles{};
+		uint64_t numCulled{};
+		uint64_t numClipped{};
+
+		// Triangles completely outside one plane are dropped, the ones crossing the near or far plane or leaving the guard band are clipped.
+		// Everything else goes to the rasterizer as is, the part outside the screen is cut off by the bounding box
+		const auto AssembleTriangle = [&](uint32_t vertexIdx0, uint32_t vertexIdx1, uint32_t vertexIdx2)
+			{
+				++numTriangles;
+				const BinnedTriangle triangle{ &mesh.vertices, &vertices_out, &material, { vertexIdx0, vertexIdx1, vertexIdx2 } };
+				const uint8_t clipCode0{ clipCodes[vertexIdx0] };
+				const uint8_t clipCode1{ clipCodes[vertexIdx1] };
+				const uint8_t clipCode2{ clipCodes[vertexIdx2] };
+
+				if (clipCode0 & clipCode1 & clipCode2 & Clipping::FrustumPlanes)
+				{
+					++numCulled;
+					return;
+				}
+
+				const uint8_t planesToClip{ static_cast<uint8_t>((clipCode0 | clipCode1 | clipCode2) & Clipping::ClipPlanes) };
+				if (planesToClip)
+				{
+					++numClipped;
+					ClipTriangle(triangle, worldViewProjectionMatrix, planesToClip, mesh.cullMode);
+					return;
+				}
 
+				if (!BinTriangle(triangle, mesh.cullMode))
+				{
+					++numCulled;
+				}
+			};
 
-		Vertex_Out v0, v1, v2;
 		switch (mesh.primitiveTopology)
 		{
 		case PrimitiveTopology::TriangleStrip:
 		{
-			for (int indicesIndex{}; indicesIndex < mesh.indices.size() - 2; indicesIndex++)
+			for (size_t indicesIndex{}; indicesIndex + 2 < mesh.indices.size(); indicesIndex++)
 			{
-
 				if (indicesIndex & 1)
 				{
-					v0 = mesh.vertices_out[mesh.indices[2 + indicesIndex]];
-					v1 = mesh.vertices_out[mesh.indices[1 + indicesIndex]];
-					v2 = mesh.vertices_out[mesh.indices[indicesIndex]];
+					AssembleTriangle(mesh.indices[2 + indicesIndex], mesh.indices[1 + indicesIndex], mesh.indices[indicesIndex]);
 				}
 				else
 				{
-					v0 = mesh.vertices_out[mesh.indices[indicesIndex]];
-					v1 = mesh.vertices_out[mesh.indices[1 + indicesIndex]];
-					v2 = mesh.vertices_out[mesh.indices[2 + indicesIndex]];
-					
-				}			
-
-				//clipping
-				if (IsVertexInFrustrum(v0.position) && IsVertexInFrustrum(v1.position) && IsVertexInFrustrum(v2.position))
-				{
-					NDCtoScreenSpace(v0, v1, v2);
-					RenderTriangle(v0, v1, v2);
+					AssembleTriangle(mesh.indices[indicesIndex], mesh.indices[1 + indicesIndex], mesh.indices[2 + indicesIndex]);
 				}
-				/*else
-				{
-					Clipping(v0, v1, v2);
-				}*/
-
 			}
 		}
 		break;
 		case PrimitiveTopology::TriangleList:
 		{
-			for (int indicesIndex{}; indicesIndex < mesh.indices.size(); indicesIndex += 3)
+			for (size_t indicesIndex{}; indicesIndex + 2 < mesh.indices.size(); indicesIndex += 3)
 			{
-				v0 = mesh.vertices_out[mesh.indices[indicesIndex]];
-				v1 = mesh.vertices_out[mesh.indices[1 + indicesIndex]];
-				v2 = mesh.vertices_out[mesh.indices[2 + indicesIndex]];
-
-				//clipping
-				if (IsVertexInFrustrum(v0.position) && IsVertexInFrustrum(v1.position) && IsVertexInFrustrum(v2.position))
-				{
-					NDCtoScreenSpace(v0, v1, v2);
-					RenderTriangle(v0, v1, v2);
-				}
+				AssembleTriangle(mesh.indices[indicesIndex], mesh.indices[1 + indicesIndex], mesh.indices[2 + indicesIndex]);
 			}
 		}
 		break;
 		}
 
+		Profiler::AddCount(ProfileCounter::TrianglesIn, numTriangles);
+		Profiler::AddCount(ProfileCounter::TrianglesCulled, numCulled);
+		Profiler::AddCount(ProfileCounter::TrianglesClipped, numClipped);
+
+	}
+
+	const Clock::time_point depthStart{ Clock::now() };
+	m_PassTimings.geometryMs = ToMilliseconds(depthStart - geometryStart);
+
+	// The passes after the first one reuse the binned triangles, the geometry only goes through the vertex stage once
+	switch (m_PipelineMode)
+	{
+	case PipelineMode::Forward:
+	{
+		RenderTiles(RasterPass::Forward);
+		m_PassTimings.depthMs = 0.f;
+		m_PassTimings.shadingMs = ToMilliseconds(Clock::now() - depthStart);
+	}
+	break;
+	case PipelineMode::Deferred:
+	{
+		RenderTiles(RasterPass::Visibility);
+		const Clock::time_point shadingStart{ Clock::now() };
+		ShadeVisibilityBuffer();
+		m_PassTimings.depthMs = ToMilliseconds(shadingStart - depthStart);
+		m_PassTimings.shadingMs = ToMilliseconds(Clock::now() - shadingStart);
+	}
+	break;
+	case PipelineMode::DepthPrepass:
+	{
+		RenderTiles(RasterPass::DepthOnly);
+		const Clock::time_point shadingStart{ Clock::now() };
+		RenderTiles(RasterPass::ShadeEqualDepth);
+		m_PassTimings.depthMs = ToMilliseconds(shadingStart - depthStart);
+		m_PassTimings.shadingMs = ToMilliseconds(Clock::now() - shadingStart);
+	}
+	break;
 	}
 }
 
-void Renderer::PixelShading(const Vertex_Out& v) const
+void Renderer::PixelShading(const Vertex_Out& v, const Material& material) const
 {
 	Vector3 lightDirection = { .577f, -.577f, .577f };
 	const float lightIntensity{ 7.f };
 	ColorRGB finalColor{ 0, 0, 0 };
 	Vector3 normal{ v.normal };
 
+	//two fetches for the four maps, see Material
+	float glossiness{};
+	const ColorRGB diffuse{ material.pDiffuseGlossiness->Sample(v.uv, v.uvDdx, v.uvDdy, m_TextureFilter, glossiness) };
+	float specularIntensity{};
+	const ColorRGB normalSample{ material.pNormalSpecular->Sample(v.uv, v.uvDdx, v.uvDdy, m_TextureFilter, specularIntensity) };
 
 	if (m_EnableNormalMap)
 	{
 		Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
 		Matrix tangentSpaceAxis = Matrix{ v.tangent, binormal, v.normal, Vector3::Zero };
 
-		const ColorRGB normalSampleVecCol{ (2 * m_pNormalTexture->Sample(v.uv)) - ColorRGB{1,1,1} };
+		const ColorRGB normalSampleVecCol{ (2 * normalSample) - ColorRGB{1,1,1} };
 		const Vector3 normalSampleVec{ normalSampleVecCol.r,normalSampleVecCol.g,normalSampleVecCol.b };
 		normal = tangentSpaceAxis.TransformVector(normalSampleVec);
 	}
 
 	
 	const float observedArea{Vector3::DotClamp(normal.Normalized(), -lightDirection)};
-	const ColorRGB lambert{ BRDF::Lambert(1.0f, m_pDiffuseTexture->Sample(v.uv))};
-	const float specularVal{ m_SpecularShininess * m_pGlossinessTexture->Sample(v.uv).r };
-	const ColorRGB specular{ m_pSpecularTexture->Sample(v.uv) * BRDF::Phong(1.0f, specularVal, -lightDirection, v.viewDirection, normal) };
+	const ColorRGB lambert{ BRDF::Lambert(1.0f, diffuse)};
+	const float specularVal{ material.shininess * glossiness };
+	const ColorRGB specular{ BRDF::Phong(specularIntensity, specularVal, -lightDirection, v.viewDirection, normal) };
 
 	switch (m_RenderMode)
 	{
@@ -976,20 +1686,22 @@ void Renderer::W2_Quad()
 	//	}
 	//};
 
-	std::vector<Mesh> meshes_world
-	{
-	Mesh
+	Mesh mesh
 	{
+		VertexStreams
 		{
-			Vertex{{ -3.0f,  3.0f, -2.0f},{1,1,1},{ 0.0f, 0.0f}},
-			Vertex{ {  0.0f,  3.0f, -2.0f},{1,1,1},{ 0.5f, 0.0f} },
-			Vertex{ {  3.0f,  3.0f, -2.0f},{1,1,1},{ 1.0f, 0.0f} },
-			Vertex{ { -3.0f,  0.0f, -2.0f},{1,1,1},{ 0.0f, 0.5f} },
-			Vertex{ {  0.0f,  0.0f, -2.0f},{1,1,1},{ 0.5f, 0.5f} },
-			Vertex{ {  3.0f,  0.0f, -2.0f},{1,1,1},{ 1.0f, 0.5f} },
-			Vertex{ { -3.0f, -3.0f, -2.0f},{1,1,1},{ 0.0f, 1.0f} },
-			Vertex{ {  0.0f, -3.0f, -2.0f},{1,1,1},{ 0.5f, 1.0f} },
-			Vertex{ {  3.0f, -3.0f, -2.0f},{1,1,1},{ 1.0f, 1.0f} },
+			std::vector<Vertex>
+			{
+				Vertex{{ -3.0f,  3.0f, -2.0f},{1,1,1},{ 0.0f, 0.0f}},
+				Vertex{ {  0.0f,  3.0f, -2.0f},{1,1,1},{ 0.5f, 0.0f} },
+				Vertex{ {  3.0f,  3.0f, -2.0f},{1,1,1},{ 1.0f, 0.0f} },
+				Vertex{ { -3.0f,  0.0f, -2.0f},{1,1,1},{ 0.0f, 0.5f} },
+				Vertex{ {  0.0f,  0.0f, -2.0f},{1,1,1},{ 0.5f, 0.5f} },
+				Vertex{ {  3.0f,  0.0f, -2.0f},{1,1,1},{ 1.0f, 0.5f} },
+				Vertex{ { -3.0f, -3.0f, -2.0f},{1,1,1},{ 0.0f, 1.0f} },
+				Vertex{ {  0.0f, -3.0f, -2.0f},{1,1,1},{ 0.5f, 1.0f} },
+				Vertex{ {  3.0f, -3.0f, -2.0f},{1,1,1},{ 1.0f, 1.0f} },
+			}
 		},
 		{
 			3,0,4,1,5,2,
@@ -997,63 +1709,16 @@ void Renderer::W2_Quad()
 			6,3,7,4,8,5
 		},
 		PrimitiveTopology::TriangleStrip,
-	},
+		CullMode::None, //the quad is shown from both sides
 	};
-
-
-
-	for (auto& mesh : meshes_world)
-	{
-		VertexTransformationFunction(mesh);
-
-
-		Vertex_Out v0, v1, v2;
-		switch (mesh.primitiveTopology)
-		{
-		case PrimitiveTopology::TriangleStrip:
-		{
-			for (int indicesIndex{}; indicesIndex < mesh.indices.size() - 2; ++indicesIndex)
-			{
-
-				if (indicesIndex % 2 == 0)
-				{
-					v0 = mesh.vertices_out[mesh.indices[indicesIndex]];
-					v1 = mesh.vertices_out[mesh.indices[1 + indicesIndex]];
-					v2 = mesh.vertices_out[mesh.indices[2 + indicesIndex]];
-				}
-				else
-				{
-					v0 = mesh.vertices_out[mesh.indices[indicesIndex]];
-					v1 = mesh.vertices_out[mesh.indices[2 + indicesIndex]];
-					v2 = mesh.vertices_out[mesh.indices[1 + indicesIndex]];
-				}
-
-				//clipping
-				if (!(IsVertexInFrustrum(v0.position) || IsVertexInFrustrum(v1.position) || IsVertexInFrustrum(v2.position)))
-				{
-					NDCtoScreenSpace(v0, v1, v2);
-					RenderTriangle(v0, v1, v2);
-				}
-
-			}
-		}
-		break;
-		case PrimitiveTopology::TriangleList:
-		{
-			for (int indicesIndex{}; indicesIndex < mesh.indices.size(); ++indicesIndex)
-			{
-				v0 = mesh.vertices_out[mesh.indices[indicesIndex]];
-				v1 = mesh.vertices_out[mesh.indices[++indicesIndex]];
-				v2 = mesh.vertices_out[mesh.indices[++indicesIndex]];
-
-				NDCtoScreenSpace(v0, v1, v2);
-				RenderTriangle(v0, v1, v2);
-			}
-		}
-		break;
-		}
-
-	}
+	mesh.CalculateBounds();
+
+	//drawn on its own with the vehicle's material
+	Scene scene{};
+	const uint32_t meshIdx{ scene.AddMesh(std::move(mesh)) };
+	const uint32_t materialIdx{ scene.AddMaterial(m_pScene->GetMaterial(m_pScene->GetInstance(m_VehicleInstanceIdx).materialIdx)) };
+	scene.AddInstance(meshIdx, materialIdx);
+	RenderScene(scene);
 }
 //week 1 and 2, not correct depth
 //void Renderer::RenderTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2) const
@@ -1269,49 +1934,3 @@ void Renderer::W2_Quad()
 //	
 //}
 #pragma endregion
-
-//void Renderer::Clipping( Vertex_Out& v0,  Vertex_Out& v1,  Vertex_Out& v2)
-//{
-//	std::vector <Vertex_Out> triangle{ v0, v1, v2 };
-//	std::vector <Vertex_Out> insideVertices;
-//	std::vector <Vertex_Out> outsideVertices;
-//
-//		for (const auto& vertex : triangle)
-//		{
-//			if (IsVertexInFrustrum(vertex.position) )
-//			{
-//				insideVertices.push_back(vertex);
-//			}
-//			else 
-//			{
-//				outsideVertices.push_back(vertex);
-//			}
-//		}
-//
-//		if (insideVertices.size() == 3) 
-//		{
-//			NDCtoScreenSpace(v0, v1, v2);
-//			RenderTriangle(v0, v1, v2);
-//		}
-//		else if (insideVertices.size() == 2)
-//		{
-//			Vertex_Out intersectionPoints[2];
-//
-//			//calculate the intersection points
-//			//
-//			//
-//			//
-//
-//			//NDC to screen space
-//
-//
-//			//Render Triangles
-//			RenderTriangle(insideVertices[0], intersectionPoints[1], intersectionPoints[0]);
-//			RenderTriangle(intersectionPoints[1], insideVertices[0], insideVertices[1]);
-//		}
-//		else
-//		{
-//			
-//		}		
-//}
-
@@ -1,27 +1,36 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "Texture.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
-	class Texture;
 	struct Mesh;
 	struct Vertex;
 	struct Vertex_Out;
 	class Timer;
 	class Scene;
+	class JobSystem;
+	struct ClipVertex;
+	struct Material;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		// workerCount is the number of threads that rasterize, 0 uses every hardware thread
+		Renderer(SDL_Window* pWindow, uint32_t workerCount = 0);
+		// Headless, renders into its own color and depth buffer of any size and never touches a window
+		// The vehicle has its material but no geometry yet, give it some with LoadMesh
+		Renderer(int width, int height, uint32_t workerCount = 0);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -32,17 +41,60 @@ namespace dae
 		void Update(Timer* pTimer);
 		void Render();
 
+		enum class PipelineMode
+		{
+			Forward,	// shade every fragment that passes the depth test
+			Deferred,	// rasterize a visibility buffer first, shade every pixel once afterwards
+			DepthPrepass,	// fill the depth buffer first, then shade only the fragments with an equal depth
+			END
+		};
+		PipelineMode GetPipelineMode() const { return m_PipelineMode; };
+		void SetPipelineMode(PipelineMode pipelineMode) { m_PipelineMode = pipelineMode; };
+
+		TextureFilter GetTextureFilter() const { return m_TextureFilter; };
+		void SetTextureFilter(TextureFilter textureFilter) { m_TextureFilter = textureFilter; };
+
+		// Everything that gets drawn. The vehicle is the first instance, LoadMesh and SetMeshRotation act on it
+		Scene& GetScene() { return *m_pScene; };
+
+		// Replaces the geometry of the vehicle, its material stays the same. Returns false if the file couldn't be parsed
+		// optimizeVertexOrder reorders triangles and vertices for locality, see VertexCache
+		// The result is cached in a .mesh file next to the OBJ and loaded from there while the OBJ doesn't change, see MeshCache
+		bool LoadMesh(const std::string& objPath, bool optimizeVertexOrder = true);
+		// Same, into a mesh of your own, for instance to add to the scene
+		bool LoadMesh(const std::string& objPath, Mesh& mesh, bool optimizeVertexOrder = true) const;
+		// For scripted runs without input: places the camera, pitch and yaw in radians like the mouse look
+		void SetCamera(const Vector3& origin, float pitch, float yaw);
+		// Sets the rotation of the mesh around its own Y axis, in degrees
+		void SetMeshRotation(float angle);
+
+		// Duration of the last frame's passes, which passes are used depends on the pipeline mode
+		struct PassTimings
+		{
+			float geometryMs{};	// vertex transformation, clipping and binning
+			float depthMs{};	// depth pre-pass or visibility buffer, 0 in forward mode
+			float shadingMs{};	// forward rasterization, equal depth pass or visibility buffer resolve
+		};
+		const PassTimings& GetPassTimings() const { return m_PassTimings; };
+
 		bool SaveBufferToImage() const;
 
+		int GetWidth() const { return m_Width; };
+		int GetHeight() const { return m_Height; };
+		// Result of the last Render, in the pixel format of the back buffer surface
+		const uint32_t* GetColorBuffer() const { return m_pBackBufferPixels; };
+		uint32_t GetColorBufferPitch() const;
+		const float* GetDepthBuffer() const { return m_pDepthBufferPixels; };
+
 		void VertexTransformationFunction(const std::vector<Vertex>& vertices_in, std::vector<Vertex>& vertices_out) const;
-		void VertexTransformationFunction(Mesh& meshes);
+		void VertexTransformationFunction(const Mesh& mesh, const Matrix& worldMatrix, TransformedVertexStreams& vertices_out);
 
 	
 
 	private:
-		SDL_Window* m_pWindow{};
+		SDL_Window* m_pWindow{}; // nullptr when headless
 
-		SDL_Surface* m_pFrontBuffer{ nullptr };
+		SDL_Surface* m_pFrontBuffer{ nullptr }; // nullptr when headless
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
 
@@ -55,21 +107,18 @@ namespace dae
 
 		float m_AspectRatio{};
 
+		bool m_F3Held{ false };
 		bool m_F4Held{false};
 		bool m_F5Held{ false };
 		bool m_F6Held{ false };
 		bool m_F7Held{ false };
+		bool m_F8Held{ false };
+		bool m_F9Held{ false };
+		bool m_F10Held{ false };
 
 		bool m_EnableNormalMap{ true };
 		bool m_EnableRotating{ false };
-
-		
-		Texture* m_pDiffuseTexture;
-		Texture* m_pSpecularTexture;
-		Texture* m_pGlossinessTexture;
-		Texture* m_pNormalTexture;
-
-		const float m_SpecularShininess{ 25.0f };
+		bool m_EnableHierarchicalRasterization{ true };
 
 		enum class RenderMode
 		{
@@ -88,15 +137,79 @@ namespace dae
 			END
 		};
 
-		
+		// What RenderTriangle does with a fragment that passes the depth test
+		enum class RasterPass
+		{
+			Forward,
+			Visibility,
+			DepthOnly,
+			ShadeEqualDepth	// no depth writes, shade only where the depth buffer matches exactly
+		};
+
+		// Forward shading happens inside the raster loop, timing every fragment would cost about as much as shading it.
+		// One in SampleRate fragments is timed and stands in for the others, RenderTiles splits the tile between the two profiler zones with it
+		struct ShadingTimeSample
+		{
+			static constexpr uint32_t SampleRate{ 16 };
+			uint32_t numFragments{};
+			std::chrono::steady_clock::duration sampledTime{};
+		};
 
 		RenderMode m_RenderMode{RenderMode::Texture};
 		ShadingMode m_ShadingMode{ShadingMode::Combined};
+		PipelineMode m_PipelineMode{ PipelineMode::Forward };
+		TextureFilter m_TextureFilter{ TextureFilter::Trilinear };
+		PassTimings m_PassTimings{};
+
+		Scene* m_pScene{};
+		uint32_t m_VehicleInstanceIdx{};
+		const Vector3 m_MeshPosition{ 0.f, 0.f, 10.f };
+
+		std::vector<uint32_t> m_VisibleInstances{}; // instances that passed the frustum test this frame
+		std::vector<TransformedVertexStreams> m_TransformedVertices{}; // per visible instance, kept between frames so they don't reallocate
 
-		Mesh* m_pMesh;
+		JobSystem* m_pJobSystem;
+		static constexpr uint32_t m_VertexChunkSize{ 1024 }; // vertices per job in the vertex stage
+
+		//tile binning
+		static constexpr int m_TileSize{ 64 };
+		int m_NumTilesX{};
+		int m_NumTilesY{};
+
+		// A triangle that survived clipping, its vertices are looked up in the streams of the mesh and those of its instance's vertex stage
+		struct BinnedTriangle
+		{
+			const VertexStreams* pVertices{};
+			const TransformedVertexStreams* pVertices_out{};
+			const Material* pMaterial{};
+			uint32_t vertexIdx[3]{};
+		};
+		std::vector<BinnedTriangle> m_BinnedTriangles{}; // in submission order
+		//vertices made by clipping this frame, the binned triangles that were clipped point into these
+		VertexStreams m_ClippedVertices{};
+		TransformedVertexStreams m_ClippedVertices_out{};
+		std::vector<std::vector<uint32_t>> m_TileBins{}; // per tile the triangle indices that overlap it
+
+		//hierarchical depth, kept up to date next to m_pDepthBufferPixels
+		int m_NumDepthBlocksX{};
+		int m_NumDepthBlocksY{};
+		mutable std::vector<float> m_BlockMinDepth{}; // nearest depth per 8x8 block
+		mutable std::vector<float> m_BlockMaxDepth{}; // farthest depth per 8x8 block
+		mutable std::vector<float> m_TileMaxDepth{}; // farthest depth per tile
+
+		//visibility buffer for deferred shading, the binned triangle and its barycentric weights per pixel
+		struct VisibilitySample
+		{
+			uint32_t triangleIdx{ UINT32_MAX };
+			float weight0{};
+			float weight1{};
+			float weight2{};
+		};
+		mutable std::vector<VisibilitySample> m_VisibilityBuffer{};
 
 
 		//private functions
+		void Initialize();
 		void RasterizationOnly();
 		void ProjectionStage();
 		void BarycenticCoordinates();
@@ -105,11 +218,22 @@ namespace dae
 		void W2_QuadNoOptimization();
 		void W2_Quad();
 
-		void RenderTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2) const;
-		void NDCtoScreenSpace(Vertex_Out& v0, Vertex_Out& v1, Vertex_Out& v2);
-		void RenderMeshes(std::vector<Mesh> meshes_world);
-		void PixelShading(const Vertex_Out& v) const;
-		//void Clipping( Vertex_Out& v0,  Vertex_Out& v1,  Vertex_Out& v2);
+		// pShadingSample is only given in forward mode while profiling
+		bool RenderTriangle(const BinnedTriangle& triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY, RasterPass pass, uint32_t triangleIdx, ShadingTimeSample* pShadingSample = nullptr) const;
+		Vertex_Out InterpolatePixel(const BinnedTriangle& triangle, int px, int py, float weight0, float weight1, float weight2, float interpolatedDepth) const;
+		void ShadeVisibilityBuffer() const;
+		// False if the triangle was culled (facing, zero area or off screen) and not binned
+		bool BinTriangle(const BinnedTriangle& triangle, CullMode cullMode);
+		void RenderTiles(RasterPass pass) const;
+		void ClearDepthBuffer();
+		void UpdateBlockMaxDepth(int blockX, int blockY) const;
+		void UpdateTileMaxDepth(int tileX, int tileY) const;
+		void NDCtoScreenSpace(Vector4& position) const;
+		Vector4 ToClipSpace(const Vector4& position) const;
+		uint32_t AddClippedVertex(const TransformedVertexStreams& vertices_out, const ClipVertex& vertex);
+		void ClipTriangle(const BinnedTriangle& triangle, const Matrix& worldViewProjectionMatrix, uint8_t clipCodes, CullMode cullMode);
+		void RenderScene(const Scene& scene);
+		void PixelShading(const Vertex_Out& v, const Material& material) const;
 		
 		
 	};
@@ -10,6 +10,7 @@
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
+#include "Profiler.h"
 
 using namespace dae;
 
@@ -47,8 +48,7 @@ int main(int argc, char* args[])
 	//Start loop
 	pTimer->Start();
 
-	// Start Benchmark
-	// TODO pTimer->StartBenchmark();
+	// Reproducible frame time measurements are done by the headless Benchmark project
 
 	float printTimer = 0.f;
 	bool isLooping = true;
@@ -67,6 +67,13 @@ int main(int argc, char* args[])
 			case SDL_KEYUP:
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
+				if (e.key.keysym.scancode == SDL_SCANCODE_P)
+				{
+					if (Profiler::WriteChromeTrace("Rasterizer_Trace.json"))
+						std::cout << "Trace saved!" << std::endl;
+					else
+						std::cout << "Something went wrong. Trace not saved!" << std::endl;
+				}
 				break;
 			}
 		}
@@ -83,7 +90,26 @@ int main(int argc, char* args[])
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			const Renderer::PassTimings& passTimings{ pRenderer->GetPassTimings() };
+			std::cout << "dFPS: " << pTimer->GetdFPS()
+				<< " (geometry " << passTimings.geometryMs << "ms, depth " << passTimings.depthMs << "ms, shading " << passTimings.shadingMs << "ms)" << std::endl;
+
+			if (Profiler::IsEnabled())
+			{
+				//zones are summed over all threads, so they can add up to more than the frame
+				const FrameProfile& profile{ Profiler::GetLastFrame() };
+				std::cout << "  frame " << profile.frameMs << "ms:";
+				for (int zoneIdx{}; zoneIdx < ProfileZoneCount; ++zoneIdx)
+				{
+					std::cout << ' ' << Profiler::GetZoneName(static_cast<ProfileZone>(zoneIdx)) << ' ' << profile.zoneMs[zoneIdx] << "ms";
+				}
+				std::cout << "\n ";
+				for (int counterIdx{}; counterIdx < ProfileCounterCount; ++counterIdx)
+				{
+					std::cout << ' ' << Profiler::GetCounterName(static_cast<ProfileCounter>(counterIdx)) << ' ' << profile.counters[counterIdx];
+				}
+				std::cout << std::endl;
+			}
 		}
 
 		//Save screenshot after full render